@@ -1,81 +1,944 @@
 #include <iostream>
+#include <algorithm>
+#include <cstdint>
 #include <iomanip>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <charconv>
+#include <limits>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <filesystem>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 // Global Constants
-const int MAX_RECORDS = 80; // (Actual Maximum Number of Records That Can Be Processed)
+const int EST_RECORD_BYTES = 32; // Estimated bytes per input line, used to pre-size the record store
+const size_t PARSE_CHUNK_BYTES = 4 << 20; // Nominal size of the newline-aligned slices handed to ingestion workers
 const int TEXT_WIDTH = 15; // Width for Car ID and Model 
 const int NUM_WIDTH = 12; // Width for Quantity and Price
-const int MIN_PRICE = 5000; // Minimum Vehicle Price
-const int MIN_MODEL_LEN = 3; // Minimum Model Name Length
-const int REQ_ID_LEN = 9; // Required Car ID length
-const int ID_PART1_END = 2; // Length of first part of Car ID
-const int ID_PART2_END = 7; // Length of the first and second part of Car ID
 const int HEADER_WIDTH = 54; // Width for header
+const int DEFAULT_PAGE_SIZE = 20; // Records per page in the paged inventory view
+const int FOLLOW_POLL_MS = 10; // How often follow mode checks the data file for appended lines
+const char SNAPSHOT_MAGIC[8] = { 'A', 'S', 'T', 'S', 'N', 'A', 'P', '\0' }; // Identifies an inventory snapshot file
+const uint32_t SNAPSHOT_VERSION = 3; // Bump whenever the snapshot layout changes
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304; // Read back differently on a machine of the other endianness
+const char JOURNAL_MAGIC[8] = { 'A', 'S', 'T', 'J', 'R', 'N', 'L', '\0' }; // Identifies an inventory journal file
+const char JOURNAL_BASE_MAGIC[8] = { 'A', 'S', 'T', 'B', 'A', 'S', 'E', '\0' }; // Identifies the base file of a journal
+const char JOURNAL_BASE_SUFFIX[] = ".base"; // A journal's base file is named after it, e.g. Inventory.journal.base
+const uint32_t JOURNAL_VERSION = 2; // Bump whenever the journal layout changes
+const int JOURNAL_COMMIT_INTERVAL_MS = 5; // Longest a journaled change waits for others to share its write and fsync
+const size_t JOURNAL_GROUP_ENTRIES = 4096; // A group commit starts early once this many changes are queued
+const size_t JOURNAL_MAX_QUEUED = 1 << 16; // Changes wait for the disk once this many are queued
+const size_t OUTPUT_BUFFER_BYTES = 1 << 20; // Size of the buffer rows are formatted into before being written out
+const size_t ERROR_BATCH_BYTES = 1 << 20; // Error report text is written out in batches of about this size
+const int ID_INDEX_MIN_SLOTS = 1024; // Smallest slot table of the car ID hash index
+const int ID_INDEX_MAX_LOAD_PERCENT = 70; // The ID index grows before more of its slots than this are used
+const size_t TEXT_ARENA_BLOCK_BYTES = 16 << 10; // Size of the blocks model names are bump-allocated from
+const int MODEL_POOL_MIN_SLOTS = 64; // Smallest slot table of a model pool's name index; kept at most half full
+const uint32_t MODEL_POOL_FREE_SLOT = 0xFFFFFFFFu; // Marks an unused slot of a model pool's name index
+const int PIPELINE_TASKS_AHEAD = 2; // Tasks each pipeline worker may finish ahead of the consumer, bounding scratch memory
+const int PARALLEL_AGGREGATE_THRESHOLD = 1 << 18; // Inventories smaller than this are always aggregated on one thread
+const int AGGREGATE_BLOCK_RECORDS = 4096; // Records reduced per block; every loop over a block reads it from cache
+const int PRICE_HISTOGRAM_BUCKETS = 10; // Equal-width price ranges in the inventory report
+const int HISTOGRAM_BAR_WIDTH = 40; // Characters in the longest histogram bar
+const int RADIX_BITS = 11; // Digit width for the radix sorts in the sort engine
+const int PARALLEL_SORT_THRESHOLD = 1 << 18; // Inventories smaller than this are always sorted on one thread
+const int TOP_K_SORT_DIVISOR = 64; // Top-K requests for more than 1/64 of the records use the cached full sort instead
+const int DEFAULT_TOP_K = 20; // Records shown when the top-K prompt gets no usable count
+const long long BENCHMARK_DEFAULT_RECORDS = 1000000; // Lines in the synthetic benchmark feed
+const double BENCHMARK_DEFAULT_INVALID_RATIO = 0.1; // Share of benchmark lines that break one validation rule
+const int BENCHMARK_DEFAULT_MODELS = 300; // Distinct model names in the benchmark feed
+const int EXIT_USAGE = 2; // Exit status for invalid command-line arguments
+const int BENCHMARK_DEFAULT_REPEAT = 3; // Runs per benchmark stage; the fastest is reported
+const long long BENCHMARK_MAX_RELOAD_ALLOCATIONS = 64; // Heap allocations a steady-state reload may make, whatever the feed size
+const int VERSION_SEGMENT_RECORDS = 1024; // Records per copy-on-write segment of a published inventory version
+const int MAX_INVENTORY_READERS = 64; // InventoryReader objects one inventory supports at the same time
+const long long STRESS_DEFAULT_RECORDS = 100000; // Records in the --stress mode inventory
+const double STRESS_DEFAULT_SECONDS = 1; // Length of each --stress round
+const int STRESS_TRANSFERS_PER_VERSION = 16; // Stock transfers the --stress writer applies between two published versions
+const double STRESS_BASE_PRICE = 10000; // The --stress writer keeps every price at this plus the record's quantity
+#ifdef _WIN32
+const char NULL_DEVICE[] = "NUL"; // Discards output written to it
+#else
+const char NULL_DEVICE[] = "/dev/null";
+#endif
+
+// Character classes for the table-driven validators
+const unsigned char CLASS_ID_LETTER = 1; // A-Z except O
+const unsigned char CLASS_ID_ALNUM = 2; // A-Z except O, or 0-9
+const unsigned char CLASS_DIGIT = 4; // 0-9
+const unsigned char CLASS_MODEL_ALNUM = 8; // A-Z, a-z, 0-9
+
+// Bits identifying the individual validation rules a rejected record failed
+const unsigned RULE_ID_LENGTH = 1 << 0; // Car ID is not REQ_ID_LEN characters long
+const int RULE_ID_SEGMENT_SHIFT = 1; // Car ID segment i of the active rule set failed: bit (RULE_ID_SEGMENT_SHIFT + i)
+const int MAX_ID_SEGMENTS = 8; // Most segments a rule set may split the Car ID into
+const unsigned RULE_MODEL_LENGTH = 1 << 9; // Model is shorter than MIN_MODEL_LEN
+const unsigned RULE_MODEL_FIRST = 1 << 10; // Model does not start with a capital letter other than O
+const unsigned RULE_MODEL_ALNUM = 1 << 11; // Model is not alphanumeric
+const unsigned RULE_QUANTITY = 1 << 12; // Quantity is below MIN_QUANTITY
+const unsigned RULE_PRICE = 1 << 13; // Price does not exceed MIN_PRICE or is not finite
+
+// Rule bits grouped by the validator that checks them
+const unsigned INVALID_ID = (1u << (RULE_ID_SEGMENT_SHIFT + MAX_ID_SEGMENTS)) - 1;
+const unsigned INVALID_MODEL = RULE_MODEL_LENGTH | RULE_MODEL_FIRST | RULE_MODEL_ALNUM;
+const unsigned INVALID_QUANTITY = RULE_QUANTITY;
+const unsigned INVALID_PRICE = RULE_PRICE;
+
+// Lookup table from character to its class bits
+struct CharClassTable {
+	unsigned char classes[256];
+};
+
+constexpr CharClassTable MakeCharClassTable() {
+	CharClassTable table{};
+	for (int c{ 0 }; c < 256; c++) {
+		bool isLetter = c >= 'A' && c <= 'Z' && c != 'O';
+		bool isDigit = c >= '0' && c <= '9';
+		bool isAlnum = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || isDigit;
+
+		table.classes[c] = (isLetter ? CLASS_ID_LETTER : 0) | (isLetter || isDigit ? CLASS_ID_ALNUM : 0)
+			| (isDigit ? CLASS_DIGIT : 0) | (isAlnum ? CLASS_MODEL_ALNUM : 0);
+	}
+	return table;
+}
+
+constexpr CharClassTable CHAR_CLASSES = MakeCharClassTable();
+
+// Run of Car ID positions [begin, end) whose characters must all belong to charClass
+struct IdSegment {
+	int begin;
+	int end;
+	unsigned char charClass;
+};
+
+// Validation rule sets. Each describes one Car ID scheme as consecutive segments, plus the record bounds.
+// Default scheme: 2 letters, 6 alphanumerics and 1 digit
+struct StandardRules {
+	static constexpr IdSegment ID_SEGMENTS[] = { { 0, 2, CLASS_ID_LETTER }, { 2, 8, CLASS_ID_ALNUM }, { 8, 9, CLASS_DIGIT } };
+	static constexpr int MIN_MODEL_LEN = 3; // Minimum Model Name Length
+	static constexpr int MIN_QUANTITY = 0; // Minimum Vehicle Quantity
+	static constexpr int MIN_PRICE = 5000; // Vehicle Price must exceed this
+};
+
+// Serial-number scheme: 2 letters, 4 alphanumerics and 3 digits
+struct SerialRules {
+	static constexpr IdSegment ID_SEGMENTS[] = { { 0, 2, CLASS_ID_LETTER }, { 2, 6, CLASS_ID_ALNUM }, { 6, 9, CLASS_DIGIT } };
+	static constexpr int MIN_MODEL_LEN = 3;
+	static constexpr int MIN_QUANTITY = 0;
+	static constexpr int MIN_PRICE = 5000;
+};
+
+// Record validator generated from a rule set at compile time. The per-position classes become a constant table
+// and the ID check is unrolled into one lookup per position, so no rule is consulted at run time.
+template <typename Rules>
+struct RuleValidator {
+	static constexpr int NUM_SEGMENTS = sizeof(Rules::ID_SEGMENTS) / sizeof(IdSegment);
+	static constexpr int ID_LENGTH = Rules::ID_SEGMENTS[NUM_SEGMENTS - 1].end;
+	static_assert(NUM_SEGMENTS <= MAX_ID_SEGMENTS, "Too many Car ID segments for the rule bits");
+
+	struct PositionClasses {
+		unsigned char classes[ID_LENGTH];
+	};
+
+	static constexpr PositionClasses MakePositionClasses() {
+		PositionClasses table{};
+		for (const IdSegment& segment : Rules::ID_SEGMENTS) {
+			for (int i{ segment.begin }; i < segment.end; i++) {
+				table.classes[i] = segment.charClass;
+			}
+		}
+		return table;
+	}
+
+	static constexpr PositionClasses ID_CLASSES = MakePositionClasses();
+
+	template <size_t... Positions>
+	static bool IdMatches(const char* carID, index_sequence<Positions...>) {
+		return ((ID_CLASSES.classes[Positions] & ~CHAR_CLASSES.classes[(unsigned char)carID[Positions]]) | ...) == 0;
+	}
+
+	static bool ModelMatches(string_view model) {
+		unsigned char missing = CLASS_ID_LETTER & ~CHAR_CLASSES.classes[(unsigned char)model[0]];
+		for (size_t i{ 1 }; i < model.length(); i++) {
+			missing |= CLASS_MODEL_ALNUM & ~CHAR_CLASSES.classes[(unsigned char)model[i]];
+		}
+		return missing == 0;
+	}
+
+	// Returns RULE_ID_LENGTH, or the bit of every segment holding a character outside its class. A wrong length
+	// is reported on its own, since the segment positions are meaningless then.
+	static unsigned IdFailures(string_view carID) {
+		if (carID.length() != ID_LENGTH) {
+			return RULE_ID_LENGTH;
+		}
+		if (IdMatches(carID.data(), make_index_sequence<ID_LENGTH>())) {
+			return 0;
+		}
+
+		unsigned failed = 0;
+		for (int s{ 0 }; s < NUM_SEGMENTS; s++) {
+			const IdSegment& segment = Rules::ID_SEGMENTS[s];
+			for (int i{ segment.begin }; i < segment.end; i++) {
+				if (!(CHAR_CLASSES.classes[(unsigned char)carID[i]] & segment.charClass)) {
+					failed |= 1u << (RULE_ID_SEGMENT_SHIFT + s);
+					break;
+				}
+			}
+		}
+		return failed;
+	}
+
+	// Returns the first model rule that fails, checked in order: length, first character, alphanumeric
+	static unsigned ModelFailures(string_view model) {
+		if (model.length() < Rules::MIN_MODEL_LEN) {
+			return RULE_MODEL_LENGTH;
+		}
+		if (ModelMatches(model)) {
+			return 0;
+		}
+		return (CHAR_CLASSES.classes[(unsigned char)model[0]] & CLASS_ID_LETTER) ? RULE_MODEL_ALNUM : RULE_MODEL_FIRST;
+	}
+
+	// Returns the RULE_* bits of every rule the record fails, or 0 for a valid record
+	static unsigned FailedRules(string_view carID, string_view model, int quantity, double price) {
+		unsigned failed = IdFailures(carID) | ModelFailures(model);
+
+		if (quantity < Rules::MIN_QUANTITY) {
+			failed |= RULE_QUANTITY;
+		}
+		if (!(price > Rules::MIN_PRICE) || !isfinite(price)) {
+			failed |= RULE_PRICE;
+		}
+		return failed;
+	}
+};
+
+// The rule set compiled in; build with -DINVENTORY_RULES=SerialRules (or another rule set) for a regional variant
+#ifndef INVENTORY_RULES
+#define INVENTORY_RULES StandardRules
+#endif
+using ActiveRules = INVENTORY_RULES;
+using ActiveValidator = RuleValidator<ActiveRules>;
+
+const int REQ_ID_LEN = ActiveValidator::ID_LENGTH; // Required Car ID length
+const int MIN_MODEL_LEN = ActiveRules::MIN_MODEL_LEN; // Minimum Model Name Length
+const int MIN_QUANTITY = ActiveRules::MIN_QUANTITY; // Minimum Vehicle Quantity
+const int MIN_PRICE = ActiveRules::MIN_PRICE; // Minimum Vehicle Price
 
 // Enumerated type for menu selection
-enum Selection { VALID = 1, INVALID, SORT, QUIT };
+enum Selection { VALID = 1, INVALID, SORT, BROWSE, FIND, QUERY, REPORT, TOP_K, FOLLOW, QUIT };
 enum Fields { ID = 1, MODEL, QUANTITY, PRICE, RETURN_TO_MAIN };
+enum BrowseOption { NEXT_PAGE = 1, PREVIOUS_PAGE, JUMP_TO_RECORD, SET_PAGE_SIZE, RETURN_FROM_BROWSE };
+enum QueryOption { SET_QUANTITY_RANGE = 1, SET_PRICE_RANGE, SET_ID_PREFIX, RUN_QUERY, CLEAR_QUERY, RETURN_FROM_QUERY };
+enum ParseMode { STREAM_PARSE = 1, MAPPED_PARSE, PARALLEL_PARSE };
+enum DuplicatePolicy { KEEP_FIRST = 1, KEEP_LAST, SUM_QUANTITIES, KEEP_ALL }; // What ingesting a record with a known car ID does
+enum OutputFormat { TABLE_FORMAT = 1, CSV_FORMAT, JSON_FORMAT };
+enum JournalChange { QUANTITY_DELTA = 1, QUANTITY_SET, PRICE_SET }; // Kinds of journal entries
+
+// Fixed-width car ID stored inline in the record store (exactly REQ_ID_LEN characters, no terminator)
+struct CarID {
+	char chars[REQ_ID_LEN];
+
+	static CarID FromString(string_view id);
+	string toString() const { return string(chars, strnlen(chars, REQ_ID_LEN)); }
+	uint64_t toKey() const;
+};
+
+// Bump allocator for strings that live as long as their owner. Text is copied into large blocks that are only
+// released together; Reset() rewinds to the first block and keeps every block for reuse, so refilling an arena to its
+// previous size allocates nothing.
+class TextArena {
+private:
+	struct Block {
+		unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	vector<Block> blocks;
+	size_t blockIndex = 0; // Block being filled
+	size_t used = 0; // Bytes used in blocks[blockIndex]
+
+public:
+	TextArena() {}
+	TextArena(const TextArena&) = delete;
+	TextArena& operator=(const TextArena&) = delete;
+	TextArena(TextArena&&) = default;
+	TextArena& operator=(TextArena&&) = default;
+
+	string_view Store(string_view text);
+	void Reset() { blockIndex = 0; used = 0; }
+};
+
+// Interning pool for model names. Each distinct name is stored once and records refer to it by a 32-bit handle,
+// assigned in first-seen order. Ranks give each handle's position in ascending name order, so models can be
+// ordered by comparing integers.
+class ModelPool {
+private:
+	TextArena text; // Bytes of every name
+	vector<string_view> names; // Views into text, indexed by handle
+	vector<uint32_t> slots; // Open-addressing index of the handles by name hash, with linear probing
+	vector<uint32_t> ranks; // Rank of each handle by name; rebuilt on demand once names were added
+
+	static uint64_t Hash(string_view name);
+	void Rehash(size_t numSlots);
+
+public:
+	ModelPool() {}
+	ModelPool(const ModelPool&) = delete;
+	ModelPool& operator=(const ModelPool&) = delete;
+	ModelPool(ModelPool&&) = default;
+	ModelPool& operator=(ModelPool&&) = default;
+
+	uint32_t Intern(string_view name);
+	string_view GetName(uint32_t handle) const { return names[handle]; }
+	int GetNumModels() const { return (int)names.size(); }
+	const vector<uint32_t>& GetRanks();
+	void Clear();
+};
+
+// Open-addressing hash index from packed car ID (CarID::toKey) to store index, with linear probing. A slot holds
+// the store index and a 32-bit tag from the key's hash; keys themselves are not stored, so a tag match is
+// confirmed by asking keyOf(index) for the stored record's key.
+class IdIndex {
+private:
+	struct Slot {
+		uint32_t tag;
+		int index; // -1 for a free slot
+	};
+
+	vector<Slot> slots;
+	int numEntries = 0;
+	int shift = 64; // Slot of a hash: its top (64 - shift) bits
+
+	static uint64_t Hash(uint64_t key);
+	template <typename KeyFunction>
+	void Rehash(size_t numSlots, KeyFunction keyOf);
+
+public:
+	template <typename KeyFunction>
+	int Find(uint64_t key, KeyFunction keyOf) const;
+	template <typename KeyFunction>
+	int Insert(uint64_t key, int index, KeyFunction keyOf);
+	template <typename KeyFunction>
+	void Reserve(int count, KeyFunction keyOf);
+	void Clear();
+	int GetNumEntries() const { return numEntries; }
+};
 
+// One inventory record: the ID inline, the model as a handle into the owning inventory's model pool
 class Car {
 private:
-	string carID;
-	string model;
+	CarID carID;
+	uint32_t modelHandle;
 	int quantity;
 	double price;
+	const ModelPool* modelPool; // Pool that modelHandle refers to; nullptr for a default-constructed Car
 
 public:
-	Car() { setCar("N/a", "N/a", 0, 0); }
-	Car(string n_carID, string n_model, int n_quantity, double n_price) { setCar(n_carID, n_model, n_quantity, n_price); }
-
-	void setCar(string n_carID, string n_model, int n_quantity, double n_price);
-	void setCarID(string n_carID) { setCar(n_carID, model, quantity, price); }
-	void setModel(string n_model) { setCar(carID, n_model, quantity, price); }
-	void setQuantity(int n_quantity) { setCar(carID, model, n_quantity, price); }
-	void setPrice(double n_price) { setCar(carID, model, quantity, n_price); }
-
-	string getCarID() const { return carID; }
-	string getModel() const { return model; }
+	Car() : carID(CarID::FromString("N/a")), modelHandle(0), quantity(0), price(0), modelPool(nullptr) {}
+	Car(const CarID& n_carID, uint32_t n_modelHandle, int n_quantity, double n_price, const ModelPool* n_modelPool)
+		: carID(n_carID), modelHandle(n_modelHandle), quantity(n_quantity), price(n_price), modelPool(n_modelPool) {}
+
+	void setCar(const CarID& n_carID, uint32_t n_modelHandle, int n_quantity, double n_price);
+	void setCarID(const CarID& n_carID) { carID = n_carID; }
+	void setModel(uint32_t n_modelHandle) { modelHandle = n_modelHandle; }
+	void setQuantity(int n_quantity) { quantity = n_quantity; }
+	void setPrice(double n_price) { price = n_price; }
+
+	string getCarID() const { return carID.toString(); }
+	uint32_t getModelHandle() const { return modelHandle; }
+	string getModel() const { return (modelPool != nullptr) ? string(modelPool->GetName(modelHandle)) : "N/a"; }
 	int getQuantity() const { return quantity; }
 	double getPrice() const { return price; }
 	string toString() const;
 };
 
+// Formats fixed-width inventory rows into a large reusable buffer and writes it out in few, large writes.
+// The bytes produced are identical to the setw/setprecision stream formatting used by Car::toString.
+class RowWriter {
+private:
+	ostream& out;
+	vector<char> buffer;
+	size_t used = 0;
 
-class Inventory {
+	void Reserve(size_t count);
+	void AppendRightJustified(const char* digits, int length, int width);
+
+public:
+	RowWriter(ostream& n_out, size_t capacity = OUTPUT_BUFFER_BYTES) : out(n_out), buffer(capacity) {}
+	~RowWriter() { Flush(); }
+	RowWriter(const RowWriter&) = delete;
+	RowWriter& operator=(const RowWriter&) = delete;
+
+	void AppendText(string_view text, int width);
+	void AppendInt(long long value, int width);
+	void AppendFixed(double value, int width);
+	void AppendChar(char c);
+	void AppendRecord(const CarID& carID, string_view model, int quantity, double price);
+	void Flush();
+};
+
+// Error report messages keyed by failed RULE_* bits, each built once however many rejected records share it
+class RuleMessageCache {
+private:
+	vector<pair<unsigned, string>> messages; // Sorted by the rule bits
+
+public:
+	const string& Get(unsigned failedRules);
+};
+
+// Record index tagged with its sort key, so sort passes stream through one contiguous array
+template <typename Key>
+struct KeyedIndex {
+	Key key;
+	int index;
+};
+
+// Read-only memory mapping of an entire file
+class MappedFile {
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = nullptr;
+#endif
+
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const string& fileName);
+	void Close();
+
+	const char* getData() const { return data; }
+	size_t getSize() const { return size; }
+};
+
+// Extracts whitespace-separated fields from one line in place, with the same semantics as 'stringstream >> field'
+class LineScanner {
 private:
-	Car cars[MAX_RECORDS];
-	Car* carPtrs[MAX_RECORDS];
+	const char* pos;
+	const char* end;
+	bool failed = false;
+
+	void SkipWhitespace();
+
+public:
+	LineScanner(const char* n_begin, const char* n_end) : pos(n_begin), end(n_end) {}
+
+	LineScanner& operator>>(string_view& token);
+	LineScanner& operator>>(int& value);
+	LineScanner& operator>>(double& value);
+};
+
+// Rejected input line in compact form: where it came from, its raw bytes (a span of the owner's rejectedText)
+// and the RULE_* bits of the rules it failed. Report text is only built from it when needed.
+struct RejectedRecord {
+	long long lineNumber;
+	size_t textOffset;
+	unsigned textLength;
+	unsigned failedRules;
+};
+
+// Fixed-size header at the start of an inventory snapshot. The sections follow it in this order, each padded to a
+// multiple of 8 bytes: car IDs, quantities, prices, model handles, model pool offsets, model pool text (names in
+// handle order), rejected records and rejected text. The checksum covers every byte after the header.
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t idLength; // REQ_ID_LEN of the rule set the records were validated with
+	uint32_t rejectedRecordBytes; // sizeof(RejectedRecord) of the writer
+	uint32_t duplicatePolicy; // Policy the store was deduplicated with
+	uint32_t reserved;
+	uint64_t numCars;
+	uint64_t numModels; // Distinct models in the model pool
+	uint64_t modelTextBytes;
+	uint64_t numRejected;
+	uint64_t rejectedTextBytes;
+	int64_t numLines;
+	int64_t consumedBytes;
+	int64_t numDuplicates;
+	int64_t dataFileSize; // Size and modification time of the data file the snapshot was built from
+	int64_t dataFileTime;
+	uint64_t checksum;
+};
+
+// Fixed-size header at the start of a journal file and of its base file; fixed-size JournalEntry records follow it
+struct JournalHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t entryBytes; // sizeof(JournalEntry) of the writer
+	uint32_t reserved;
+	uint64_t firstSequence; // Sequence of the first entry; a base file numbers its entries from 0
+	uint64_t baseSequence; // Base file only: every journal entry before this sequence is folded into it
+};
+
+// One journaled change to the record with carID. Entries carry consecutive sequence numbers and a checksum, so a
+// torn write at the end of the file is recognized and dropped.
+struct JournalEntry {
+	uint64_t sequence;
+	CarID carID;
+	uint8_t kind; // JournalChange
+	uint8_t reserved[2];
+	int32_t quantity; // Delta for QUANTITY_DELTA, new quantity for QUANTITY_SET
+	double price; // New price for PRICE_SET
+	uint64_t checksum; // Checksum64 of the bytes before it
+};
+
+// Valid and rejected records produced from one slice of the data file; rejected line numbers count from the slice start
+struct ParsedChunk {
+	const char* begin = nullptr;
+	const char* end = nullptr;
+	long long numLines = 0;
+	vector<CarID> carIDs;
+	vector<uint64_t> idKeys; // Packed carIDs, computed by the parsing worker for the ID index
+	vector<uint32_t> modelHandles; // Handles into the chunk's own modelPool, remapped when the chunk is appended
+	vector<int> quantities;
+	vector<double> prices;
+	ModelPool modelPool;
+	vector<RejectedRecord> rejectedRecords;
+	string rejectedText;
+};
+
+// One feed file of a sharded load: parsed on its own worker, then appended to the inventory in feed order
+struct FeedShard {
+	ParsedChunk chunk; // Every line of the file
+	vector<int> order; // Chunk records in the feed sort field's order, when one was requested
+	vector<int> storeIndices; // Store index of each chunk record once appended; -1 - index if it was folded into that record
+	bool opened = false;
+};
+
+// Fastest run of a benchmark stage; allocations is -1 unless the build counts them
+struct BenchmarkRun {
+	double seconds;
+	long long allocations;
+};
+
+// Shape of the synthetic feed and the runs of the --benchmark mode
+struct BenchmarkConfig {
+	long long numRecords = BENCHMARK_DEFAULT_RECORDS;
+	double invalidRatio = BENCHMARK_DEFAULT_INVALID_RATIO;
+	double duplicateRatio = 0; // Share of lines that reuse the car ID of an earlier line
+	bool sequentialIds = false; // Car IDs ascend through the ID space instead of being drawn at random
+	int numModels = BENCHMARK_DEFAULT_MODELS;
+	double modelSkew = 0; // Zipf exponent of the model popularity; 0 draws every model equally often
+	uint64_t seed = 1;
+	int repeat = BENCHMARK_DEFAULT_REPEAT;
+};
+
+// Fields of every generated line, kept so the validators can be timed without the parser
+struct BenchmarkFeed {
+	string text;
+	vector<string_view> carIDs;
+	vector<string_view> models;
+	vector<int> quantities;
+	vector<double> prices;
+};
+
+// Record filter for Inventory::Query. Every criterion is optional; the defaults match every record.
+struct InventoryQuery {
+	int minQuantity = numeric_limits<int>::min();
+	int maxQuantity = numeric_limits<int>::max();
+	double minPrice = -numeric_limits<double>::infinity();
+	double maxPrice = numeric_limits<double>::infinity();
+	string idPrefix; // Upper case; empty for any ID
+
+	bool HasQuantityRange() const { return minQuantity != numeric_limits<int>::min() || maxQuantity != numeric_limits<int>::max(); }
+	bool HasPriceRange() const { return minPrice != -numeric_limits<double>::infinity() || maxPrice != numeric_limits<double>::infinity(); }
+	bool HasCriteria() const { return HasQuantityRange() || HasPriceRange() || !idPrefix.empty(); }
+	string toString() const;
+};
+
+// Files an inventory reads and writes; the defaults are the ones the interactive program uses
+struct InventoryFiles {
+	string dataFileName{ "Data.txt" };
+	string errorFileName{ "ErrorFile.txt" };
+	string snapshotFileName{ "Inventory.snapshot" };
+	vector<string> feedFileNames; // When not empty, these feeds are loaded as shards instead of dataFileName
+	int feedSortField = 0; // Field the shards are sorted by while they load, so its cached order is ready; 0 for none
+	string journalFileName; // Journal of quantity and price changes, replayed after loading; empty for none
+};
+
+// What a --batch run loads and prints
+struct BatchConfig {
+	InventoryFiles files;
+	bool writeErrorFile = false; // Only when --errors names a file
+	bool useSnapshot = false;
+	DuplicatePolicy duplicatePolicy = KEEP_ALL;
+	InventoryQuery query;
+	int sortField = 0; // 0 keeps file order
+	long long limit = -1; // Most records printed; -1 for all
+	OutputFormat format = TABLE_FORMAT;
+	string movementsFileName; // Stock movements to apply before printing; empty for none
+	bool compactJournal = false;
+};
+
+// Per-model totals of the inventory report; kept together so the group-by touches one cache line per record
+struct ModelTotals {
+	long long numCars = 0;
+	long long quantity = 0;
+	double value = 0;
+};
+
+// Column reductions over the record store, produced by Inventory::Aggregate
+struct InventoryAggregate {
+	long long numCars = 0;
+	long long totalQuantity = 0;
+	long long numOutOfStock = 0; // Records with a quantity of 0
+	double totalValue = 0; // Sum of quantity * price
+	double priceSum = 0;
+	int minQuantity = numeric_limits<int>::max();
+	int maxQuantity = numeric_limits<int>::min();
+	double minPrice = numeric_limits<double>::infinity();
+	double maxPrice = -numeric_limits<double>::infinity();
+	vector<long long> priceHistogram; // PRICE_HISTOGRAM_BUCKETS equal-width buckets from minPrice to maxPrice
+	vector<ModelTotals> modelTotals; // Group-by model, indexed by model handle
+
+	void Merge(const InventoryAggregate& other);
+};
+
+// VERSION_SEGMENT_RECORDS consecutive records of a published version. Never modified once published; a segment the
+// writer has not changed is shared by every version since it was copied.
+struct ColumnSegment {
+	CarID carIDs[VERSION_SEGMENT_RECORDS];
+	uint32_t modelHandles[VERSION_SEGMENT_RECORDS];
+	int quantities[VERSION_SEGMENT_RECORDS];
+	double prices[VERSION_SEGMENT_RECORDS];
+};
+
+// Immutable state of the record store as of one Inventory::Publish call
+struct InventoryVersion {
+	uint64_t number = 0; // Counts up from 1 with every publication
 	int numCars = 0;
+	vector<shared_ptr<const ColumnSegment>> segments; // Record i is in segments[i / VERSION_SEGMENT_RECORDS]
+	shared_ptr<const ModelPool> models; // Same handles as the inventory's pool
+	shared_ptr<const vector<uint32_t>> modelRanks;
+};
+
+// Epoch announced by one InventoryReader; on its own cache line so readers do not slow each other down
+struct alignas(64) ReaderSlot {
+	atomic<bool> inUse{ false };
+	atomic<uint64_t> epoch{ 0 }; // Epoch of the version the reader holds; 0 while it holds none
+};
+
+// Append-only journal of record changes with group commit. Append only queues an entry; a committer thread writes
+// everything queued with one write and one fsync at most every JOURNAL_COMMIT_INTERVAL_MS (sooner once
+// JOURNAL_GROUP_ENTRIES are queued or a caller waits in Sync), so any number of changes share each sync.
+class Journal {
+private:
+	string fileName;
+	string baseFileName; // Net changes of the entries compacted out of the file
+	FILE* file = nullptr;
+	uint64_t firstSequence; // Sequence of the file's first entry
+	mutex fileMutex; // Held while the file is written or replaced
+	mutex queueMutex;
+	condition_variable queueSignal; // Wakes the committer
+	condition_variable durableSignal; // Wakes callers waiting for the disk or for queue space
+	vector<JournalEntry> queued;
+	uint64_t nextSequence; // Sequence the next appended entry gets
+	uint64_t durableSequence; // Entries before this one are on disk
+	bool syncRequested = false;
+	bool stopping = false;
+	long long numSyncs = 0;
+	thread committer;
+
+	void CommitLoop();
+	void WriteEntries(const vector<JournalEntry>& entries);
+	void OpenFile();
+	void Rebase(uint64_t newFirstSequence);
+	static bool WriteHeader(FILE* file, const char* magic, uint64_t firstSequence, uint64_t baseSequence);
+
+public:
+	Journal(const string& n_fileName, uint64_t n_firstSequence, uint64_t n_nextSequence);
+	~Journal();
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	void Append(JournalEntry entry);
+	uint64_t Sync();
+	bool Compact();
+	long long GetNumSyncs();
+	static bool SyncFile(FILE* file);
+};
+
+// Options of the --stress mode
+struct StressConfig {
+	long long numRecords = STRESS_DEFAULT_RECORDS;
+	int maxReaders = max(1, (int)thread::hardware_concurrency()); // Rounds run with 1, 2, 4, ... readers up to this many
+	double seconds = STRESS_DEFAULT_SECONDS;
+	uint64_t seed = 1;
+};
+
+class Inventory {
+private:
+	// Record store: one slot per valid car, with the hot fields kept in contiguous columns
+	vector<CarID> carIDs;
+	vector<uint32_t> modelHandles; // Handles into modelPool
+	vector<int> quantities;
+	vector<double> prices;
+	ModelPool modelPool;
+	IdIndex idIndex; // Store index of every car ID; may lag the store after a snapshot load, see EnsureIdIndex
+	int numIndexed = 0; // Records [0, numIndexed) are in idIndex
+	DuplicatePolicy duplicatePolicy;
+	long long numDuplicates = 0; // Ingested records whose car ID was already in the store
+	vector<int> fieldOrders[PRICE + 1]; // Cached descending permutation per sort field, indexed by Fields (entry 0 unused)
+	int displayField = 0; // Field the inventory is displayed by; 0 means store (file) order
+	ParseMode parseMode;
+	int sortThreads = max(1, (int)thread::hardware_concurrency());
+
+	// Error store: every rejected line of the data file, in file order
+	vector<RejectedRecord> rejectedRecords;
+	string rejectedText; // Raw bytes of the rejected lines, referenced by RejectedRecord spans
+	long long numLines = 0; // Lines of the data file consumed so far
+	long long consumedBytes = 0; // Offset in the data file just past the last consumed line
+	string pendingLine; // Unterminated last line, parsed on load but not consumed until its newline arrives
+	bool writeErrorFile;
+	future<void> errorFileFlush; // Pending asynchronous write of ErrorFile.txt
+	bool useSnapshot; // Start from the snapshot file when it matches the data file, and write one after parsing
+	InventoryFiles files;
+
+	// Ingestion scratch, kept across chunks and reloads so steady-state parsing does not allocate per record
+	vector<ParsedChunk> spareChunks; // Emptied chunks whose buffers the next ParseChunk calls reuse
+	mutex spareChunksMutex;
+	vector<uint32_t> handleMap; // Chunk-to-inventory model handles of the chunk being appended
+
+	// Published versions for InventoryReader. Readers never lock: each announces the epoch it started reading in,
+	// and a replaced version is only freed once every reader has announced a later epoch.
+	atomic<const InventoryVersion*> publishedVersion{ nullptr };
+	atomic<uint64_t> readEpoch{ 1 };
+	ReaderSlot readerSlots[MAX_INVENTORY_READERS];
+	vector<pair<uint64_t, const InventoryVersion*>> retiredVersions; // Replaced versions and the epoch they were replaced in
+	vector<char> dirtySegments; // Segments with records changed since the last Publish, by segment index
+	bool republishAll = true; // The store was cleared since the last Publish, so no segment can be shared
+
+	// Journal of changes made since the store was loaded (see OpenJournal and CompactJournal)
+	unique_ptr<Journal> journal;
+	future<void> journalCompaction; // Pending background compaction
+
+	friend class InventoryReader;
+
+	void ParseStreamData();
+	void ParseMappedData(int numThreads);
+	bool LoadSnapshot();
+	void WriteSnapshot();
+	void OpenJournal();
+	bool ApplyJournalEntry(const JournalEntry& entry);
+	void LogChange(int index, JournalChange kind, int quantity, double price);
+	void ParseRange(const char* data, const char* end, int numThreads);
+	void ParseFeeds(int numThreads);
+	void ParseChunk(ParsedChunk& chunk);
+	void AppendChunk(ParsedChunk& chunk, vector<int>* storeIndices = nullptr);
+	void TakeSpareChunk(ParsedChunk& chunk);
+	void RecycleChunk(ParsedChunk& chunk);
+	int AddRecord(const CarID& carID, uint64_t idKey, uint32_t modelHandle, int quantity, double price);
+	void SortShard(FeedShard& shard, int field);
+	void MergeShardOrders(vector<FeedShard>& shards, int field);
+	template <typename Key, typename KeyFunction>
+	void MergeRuns(KeyFunction keyOf, vector<vector<int>>& runs, vector<int>& order);
+	void EnsureIdIndex();
+	void AddRejectedRecord(const char* lineBegin, const char* lineEnd, unsigned failedRules);
+	void FlushErrorFile(ofstream&& Errfile, size_t firstRecord = 0);
+	void WriteRejectedRecord(ostream& out, const RejectedRecord& record, RuleMessageCache& messages);
+	template <typename Key, typename KeyFunction>
+	void SortByKey(KeyFunction keyOf, vector<int>& order);
+	template <typename Key, typename KeyFunction>
+	void SelectTopByKey(KeyFunction keyOf, int k, vector<int>& top);
+	template <typename Key, typename KeyFunction>
+	void OrderByKey(KeyFunction keyOf, vector<int>& indices, size_t limit);
+	uint64_t IdSortKey(int index) const { return ~carIDs[index].toKey(); }
+	uint32_t ModelSortKey(int index, const vector<uint32_t>& ranks) const { return ~ranks[modelHandles[index]]; }
+	uint32_t QuantitySortKey(int index) const { return QuantityKey(quantities[index]); }
+	uint64_t PriceSortKey(int index) const { return PriceKey(prices[index]); }
+	static uint32_t QuantityKey(int quantity) { return ~((uint32_t)quantity ^ 0x80000000u); }
+	static uint64_t PriceKey(double price);
+	bool MatchesQuery(int index, const InventoryQuery& query) const;
+	pair<int, int> QuantityRange(int minQuantity, int maxQuantity);
+	pair<int, int> PriceRange(double minPrice, double maxPrice);
+	pair<int, int> IdPrefixRange(const string& prefix);
+	void MarkDirty(int index);
+	void ReclaimVersions();
+	static void ReduceColumns(const int* quantity, const double* price, const uint32_t* modelHandle, int first, int last,
+		int numModels, InventoryAggregate& partial);
+	static void CountPrices(const double* price, int first, int last, double minPrice, double bucketWidth, vector<long long>& histogram);
 
 public:
-	Inventory() { ParseData(); }
+	Inventory(ParseMode n_parseMode = PARALLEL_PARSE, bool n_writeErrorFile = true, bool n_useSnapshot = true, DuplicatePolicy n_duplicatePolicy = KEEP_ALL,
+		const InventoryFiles& n_files = InventoryFiles())
+		: duplicatePolicy(n_duplicatePolicy), parseMode(n_parseMode), writeErrorFile(n_writeErrorFile), useSnapshot(n_useSnapshot), files(n_files) {
+		ParseData();
+		OpenJournal();
+	}
+	~Inventory();
+
+	int GetNumInvalidRecords() const { return (int)rejectedRecords.size(); }
+	long long GetNumLines() const { return numLines; }
+	void WaitForErrorFile();
+
+	int GetNumCars() const { return (int)quantities.size(); }
+	void SetSortThreads(int n_sortThreads) { sortThreads = max(1, n_sortThreads); }
+	void Reserve(int capacity);
+	void AddCar(const string& carID, const string& model, int quantity, double price);
+	Car GetCar(int index) const;
+	int FindCar(string_view carID);
+	int Query(const InventoryQuery& query, vector<int>& matches);
+	InventoryAggregate Aggregate();
+	long long GetNumDuplicates() const { return numDuplicates; }
 
-	void setNumCars(int n_numCars) { numCars = n_numCars; }
 	void ParseData();
-	bool ValidateRecord(string carID, string model, int quantity, double price, string& errorMessage);
-	bool ValidateCarID(string carID, string& errorMessage);
-	bool ValidateModel(string model, string& errorMessage);
-	bool ValidateQuantity(int quantity, string& errorMessage);
-	bool ValidatePrice(double price, string& errorMessage);
+	long long IngestAppended();
+	void Clear();
+	bool IsValidRecord(string_view carID, string_view model, int quantity, double price) const;
+	unsigned ValidateRecord(string_view carID, string_view model, int quantity, double price) const;
+	unsigned ValidateCarID(string_view carID) const;
+	unsigned ValidateModel(string_view model) const;
+	unsigned ValidateQuantity(int quantity) const;
+	unsigned ValidatePrice(double price) const;
+	void SetQuantity(int index, int quantity);
+	bool AdjustQuantity(int index, int delta);
+	void SetPrice(int index, double price);
+	void Publish();
+	void WaitForJournal();
+	void CompactJournal();
+	void WaitForCompaction();
+	long long GetJournalSyncs() { return (journal != nullptr) ? journal->GetNumSyncs() : 0; }
 	void SortBy(int field);
+	const vector<int>& GetSortedOrder(int field);
+	void TopK(int field, int k, vector<int>& top);
+	void OrderBy(int field, vector<int>& indices, size_t limit);
+	void InvalidateOrder(int field) { fieldOrders[field].clear(); }
+	void SortByID(vector<int>& order);
+	void SortByModel(vector<int>& order);
+	void SortByQuantity(vector<int>& order);
+	void SortByPrice(vector<int>& order);
 
 	void MakeStringUppercase(string& str);
 	void PrintInventory();
+	void PrintCar(int index);
+	void PrintRecords(const string& title, const vector<int>& indices);
+	void WriteRecords(ostream& out, const vector<int>& indices, OutputFormat format);
+	void PrintReport();
+	void PrintInvalidRecords();
+	void PrintPage(int offset, int pageSize);
+	void WriteRows(int first, int last);
+};
+
+// Snapshot-isolated read access to an inventory, for use from any thread while one writer thread modifies it and
+// calls Publish. A reader sees the version that was published when it was created or last refreshed, whole and
+// unchanged, however the writer goes on; neither side ever waits for the other.
+class InventoryReader {
+private:
+	Inventory& inventory;
+	int slot; // This reader's entry in inventory.readerSlots
+	const InventoryVersion* version = nullptr; // nullptr until the inventory publishes its first version
+
+	const ColumnSegment& SegmentOf(int index) const { return *version->segments[index / VERSION_SEGMENT_RECORDS]; }
+
+public:
+	explicit InventoryReader(Inventory& n_inventory);
+	~InventoryReader();
+	InventoryReader(const InventoryReader&) = delete;
+	InventoryReader& operator=(const InventoryReader&) = delete;
+
+	void Refresh();
+	uint64_t GetVersion() const { return (version != nullptr) ? version->number : 0; }
+	int GetNumCars() const { return (version != nullptr) ? version->numCars : 0; }
+	Car GetCar(int index) const;
+	InventoryAggregate Aggregate() const;
+	void SortBy(int field, vector<int>& order) const;
 };
 
 // Function Prototypes
 int GetMenuSelection();
 void SortMenu(Inventory& inventory); // Wrapper function for sorting menu
 int GetSortKey();
-void PrintInvalidRecords();
+void BrowseMenu(Inventory& inventory);
+int GetBrowseOption();
+void FindMenu(Inventory& inventory);
+void QueryMenu(Inventory& inventory);
+void TopKMenu(Inventory& inventory);
+int GetQueryOption(const InventoryQuery& query);
+void FollowMenu(Inventory& inventory);
+void PrintTableHeader(const string& title);
 void PurgeInputErrors(string errMess);
+string DescribeIdSegment(const IdSegment& segment);
+string DescribeFailedRules(unsigned failedRules);
+uint64_t Checksum64(const char* data, size_t size, uint64_t hash);
+bool SyncFileName(const string& fileName);
+bool SyncDirectoryOf(const string& fileName);
+uint64_t JournalChecksum(const JournalEntry& entry);
+bool ReadJournalFile(const string& fileName, const char* magic, JournalHeader& header, vector<JournalEntry>& entries, bool& torn);
+void FoldJournalEntries(vector<JournalEntry>& entries);
+void RunParallel(int numTasks, const function<void(int)>& task);
+void RunPipelined(int numTasks, int numThreads, const function<void(int)>& produce, const function<void(int)>& consume);
+template <typename Key>
+void RadixSort(vector<KeyedIndex<Key>>& items);
+int RunBatch(int argc, char* argv[]);
+void ParseBatchArgs(int argc, char* argv[], BatchConfig& config);
+bool ApplyMovements(Inventory& inventory, const string& fileName);
+int RunBenchmark(int argc, char* argv[]);
+void ParseBenchmarkArgs(int argc, char* argv[], BenchmarkConfig& config);
+void GenerateBenchmarkFeed(const BenchmarkConfig& config, BenchmarkFeed& feed);
+template <typename Work>
+BenchmarkRun TimeBest(int repeat, Work work);
+void ReportBenchmark(const string& stage, long long records, const BenchmarkRun& run);
+long long PeakRssKB();
+long long GetNumAllocations();
+int RunStress(int argc, char* argv[]);
+void ParseStressArgs(int argc, char* argv[], StressConfig& config);
+filesystem::path EnterScratchDirectory(const string& prefix);
+
+int main(int argc, char* argv[]) {
+	if (argc > 1 && string_view(argv[1]) == "--batch") {
+		return RunBatch(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && string_view(argv[1]) == "--benchmark") {
+		return RunBenchmark(argc - 2, argv + 2);
+	}
+	else if (argc > 1 && string_view(argv[1]) == "--stress") {
+		return RunStress(argc - 2, argv + 2);
+	}
+	else if (argc > 1) {
+		cerr << "ERROR: Unknown option '" << argv[1] << "'. Use --batch, --benchmark or --stress, or no options for the menu\n";
+		return EXIT_USAGE;
+	}
 
-int main() {
 	Inventory inventory;
 	int selection;
 
@@ -87,11 +950,29 @@ int main() {
 			inventory.PrintInventory();
 			break;
 		case INVALID:
-			PrintInvalidRecords();
+			inventory.PrintInvalidRecords();
 			break;
 		case SORT:
 			SortMenu(inventory);
 			break;
+		case BROWSE:
+			BrowseMenu(inventory);
+			break;
+		case FIND:
+			FindMenu(inventory);
+			break;
+		case QUERY:
+			QueryMenu(inventory);
+			break;
+		case REPORT:
+			inventory.PrintReport();
+			break;
+		case TOP_K:
+			TopKMenu(inventory);
+			break;
+		case FOLLOW:
+			FollowMenu(inventory);
+			break;
 		case QUIT:
 			cout << "Terminating Program\n";
 			break;
@@ -103,392 +984,4008 @@ int main() {
 	return 0;
 }
 
-void Car::setCar(string n_carID, string n_model, int n_quantity, double n_price) {
+void Car::setCar(const CarID& n_carID, uint32_t n_modelHandle, int n_quantity, double n_price) {
 	carID = n_carID;
-	model = n_model;
+	modelHandle = n_modelHandle;
 	quantity = n_quantity;
 	price = n_price;
 }
 
-string Car::toString() const {
-	stringstream recordString;
-	recordString << fixed << showpoint << setprecision(2) << left << setw(TEXT_WIDTH) << carID << setw(TEXT_WIDTH) << model
-		<< setw(NUM_WIDTH) << right << quantity << setw(NUM_WIDTH) << price << left << endl;
+// Copies text into the current block, moving on to the next block (or a new one) when it does not fit
+string_view TextArena::Store(string_view text) {
+	while (blockIndex < blocks.size() && used + text.size() > blocks[blockIndex].size) {
+		blockIndex++;
+		used = 0;
+	}
+	if (blockIndex == blocks.size()) {
+		size_t size = max(TEXT_ARENA_BLOCK_BYTES, text.size());
+		blocks.push_back({ unique_ptr<char[]>(new char[size]), size });
+	}
 
-	return recordString.str();
+	char* copy = blocks[blockIndex].data.get() + used;
+	memcpy(copy, text.data(), text.size());
+	used += text.size();
+	return string_view(copy, text.size());
 }
 
-void Inventory::ParseData() {
-	string fileName{ "Data.txt" };
-	string errorFileName{ "ErrorFile.txt" };
-	stringstream ssHeader;
+// FNV-1a over the name's bytes
+uint64_t ModelPool::Hash(string_view name) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : name) {
+		hash = (hash ^ (unsigned char)c) * 0x100000001b3ull;
+	}
+	return hash;
+}
 
-	cout << fixed << showpoint << setprecision(2);
-	ssHeader << fixed << showpoint << setprecision(2) << left
-		<< setw(TEXT_WIDTH) << "Vehicle ID"
-		<< setw(TEXT_WIDTH) << "Model"
-		<< setw(NUM_WIDTH) << right << "Quantity"
-		<< setw(NUM_WIDTH) << "Price" << left << "\n\n";
+// Returns the handle of name, adding it to the pool if it is new
+uint32_t ModelPool::Intern(string_view name) {
+	if ((names.size() + 1) * 2 > slots.size()) {
+		Rehash(max<size_t>(MODEL_POOL_MIN_SLOTS, slots.size() * 2));
+	}
 
-	ifstream Infile(fileName);
-	if (!Infile.is_open()) {
-		cout << "ERROR: Unable to open '" << fileName << "'. Terminating Program\n";
-		exit(EXIT_FAILURE);
+	size_t mask = slots.size() - 1;
+	for (size_t slot = (size_t)(Hash(name) & mask); ; slot = (slot + 1) & mask) {
+		uint32_t handle = slots[slot];
+		if (handle == MODEL_POOL_FREE_SLOT) {
+			handle = (uint32_t)names.size();
+			names.push_back(text.Store(name));
+			slots[slot] = handle;
+			return handle;
+		}
+		if (names[handle] == name) {
+			return handle;
+		}
 	}
-	else if (Infile.peek() == EOF) {
-		cout << "ERROR: '" << fileName << "' is empty. No data to process. Terminating Program\n";
-		exit(EXIT_FAILURE);
+}
+
+// Rebuilds the name index with numSlots slots (a power of 2)
+void ModelPool::Rehash(size_t numSlots) {
+	slots.assign(numSlots, MODEL_POOL_FREE_SLOT);
+
+	size_t mask = numSlots - 1;
+	for (uint32_t handle{ 0 }; handle < names.size(); handle++) {
+		size_t slot = (size_t)(Hash(names[handle]) & mask);
+		while (slots[slot] != MODEL_POOL_FREE_SLOT) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = handle;
 	}
+}
 
-	ofstream Errfile(errorFileName);
-	if (!Errfile) {
-		cout << "ERROR: Unable to open '" << errorFileName << "'. Terminating Program\n";
-		Infile.close();
-		exit(EXIT_FAILURE);
+// Returns the rank of every handle in ascending name order, re-ranking only when names were added since the last call
+const vector<uint32_t>& ModelPool::GetRanks() {
+	if (ranks.size() != names.size()) {
+		vector<uint32_t> byName(names.size());
+		for (uint32_t h{ 0 }; h < byName.size(); h++) {
+			byName[h] = h;
+		}
+		sort(byName.begin(), byName.end(), [this](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+
+		ranks.resize(names.size());
+		for (uint32_t r{ 0 }; r < byName.size(); r++) {
+			ranks[byName[r]] = r;
+		}
 	}
+	return ranks;
+}
 
-	string errorMessage{ "" };
-	string carID, model;
-	int quantity;
-	double price;
-	bool isValidRecord;
-	int currentRecord{ 0 };
-	int totalCars = 0;
-	string line;
+// Empties the pool but keeps its name blocks and index, so it refills without allocating
+void ModelPool::Clear() {
+	text.Reset();
+	names.clear();
+	fill(slots.begin(), slots.end(), MODEL_POOL_FREE_SLOT);
+	ranks.clear();
+}
 
-	while (getline(Infile, line) && currentRecord < MAX_RECORDS) {
-		errorMessage = ""; // Reset error message before each line is read
-		stringstream ss(line);
-		ss >> carID >> model >> quantity >> price;
+// Reserves room for at least capacity records in every column
+void Inventory::Reserve(int capacity) {
+	carIDs.reserve(capacity);
+	modelHandles.reserve(capacity);
+	quantities.reserve(capacity);
+	prices.reserve(capacity);
+	idIndex.Reserve(capacity, [this](int index) { return carIDs[index].toKey(); });
+}
 
-		isValidRecord = ValidateRecord(carID, model, quantity, price, errorMessage);
+// Adds a validated record to the store; carID must be exactly REQ_ID_LEN characters
+void Inventory::AddCar(const string& carID, const string& model, int quantity, double price) {
+	CarID id = CarID::FromString(carID);
+	AddRecord(id, id.toKey(), modelPool.Intern(model), quantity, price);
+}
 
-		if (isValidRecord) {
-			MakeStringUppercase(carID);
-			MakeStringUppercase(model);
+// Appends a record to the store, or applies the duplicate policy if its car ID (packed as idKey) is already there.
+// A record that replaces or merges into an earlier one keeps the earlier one's position in the store. Under KEEP_ALL
+// a repeated ID is appended like any other record, and FindCar finds the first record with it.
+// Returns the store index of the record, or of the earlier record it was folded into.
+int Inventory::AddRecord(const CarID& carID, uint64_t idKey, uint32_t modelHandle, int quantity, double price) {
+	auto keyOf = [this](int index) { return carIDs[index].toKey(); };
 
-			cars[totalCars].setCar(carID, model, quantity, price);
-			carPtrs[totalCars] = &cars[totalCars];
-			totalCars++;
-		}
-		else {
-			Errfile << left << setw(TEXT_WIDTH) << carID << setw(TEXT_WIDTH) << model << setw(NUM_WIDTH) << right << quantity
-				<< setw(NUM_WIDTH) << right << price << left << " " << errorMessage << "\n";
-		}
-		currentRecord++;
+	EnsureIdIndex();
+	int existing = idIndex.Insert(idKey, GetNumCars(), keyOf);
+
+	if (existing >= 0) {
+		numDuplicates++;
+	}
+	if (existing < 0 || duplicatePolicy == KEEP_ALL) {
+		carIDs.push_back(carID);
+		modelHandles.push_back(modelHandle);
+		quantities.push_back(quantity);
+		prices.push_back(price);
+		numIndexed++;
+		return GetNumCars() - 1;
 	}
 
-	// Check if records processed exceeds the total number of records
-	if (currentRecord == MAX_RECORDS && !Infile.eof()) {
-		cout << "ERROR: The total number of records exceed the maximum limit of " << MAX_RECORDS
-			<< ". Any records beyond the maximum " << MAX_RECORDS << " will be discarded.\n\n";
+	switch (duplicatePolicy) {
+	case KEEP_FIRST:
+	case KEEP_ALL:
+		break;
+	case KEEP_LAST:
+		modelHandles[existing] = modelHandle;
+		quantities[existing] = quantity;
+		prices[existing] = price;
+		InvalidateOrder(MODEL);
+		InvalidateOrder(QUANTITY);
+		InvalidateOrder(PRICE);
+		MarkDirty(existing);
+		break;
+	case SUM_QUANTITIES:
+		// Saturates rather than wrapping, so a sum too large for an int cannot turn negative
+		quantities[existing] = (int)min<long long>((long long)quantities[existing] + quantity, numeric_limits<int>::max());
+		InvalidateOrder(QUANTITY);
+		MarkDirty(existing);
+		break;
 	}
-	setNumCars(totalCars);
-	Infile.close();
-	Errfile.close();
+	return existing;
 }
 
-// Calls individual validator functions and returns true if all validators return true
-bool Inventory::ValidateRecord(const string carID, const string model, const int quantity, const double price, string& errorMessage) {
-	bool validID, validModel, validQuantity, validPrice;
+// Indexes the records the ID index does not cover yet; only a snapshot load leaves records unindexed
+void Inventory::EnsureIdIndex() {
+	int numCars = GetNumCars();
+	auto keyOf = [this](int index) { return carIDs[index].toKey(); };
 
-	validID = ValidateCarID(carID, errorMessage);
-	validModel = ValidateModel(model, errorMessage);
-	validQuantity = ValidateQuantity(quantity, errorMessage);
-	validPrice = ValidatePrice(price, errorMessage);
-
-	return (validID && validModel && validQuantity && validPrice);
+	if (numIndexed < numCars) {
+		idIndex.Reserve(numCars, keyOf);
+		for (int i{ numIndexed }; i < numCars; i++) {
+			idIndex.Insert(carIDs[i].toKey(), i, keyOf);
+		}
+		numIndexed = numCars;
+	}
 }
 
-// Validate the car ID by checking if the length is 9 characters, the first 2 characters are letters, the next 4 characters are alphanumeric, and the remaining 3 are numbers
-bool Inventory::ValidateCarID(string carID, string& errorMessage) {
-	bool isValidID = false;
-	bool isValidLength = true;
-	bool validReq1 = true, validReq2 = true, validReq3 = true;
-	string errorMessageTemp{ "" };
-
+// Returns the store index of the car with the given ID, or -1 if there is none
+int Inventory::FindCar(string_view carID) {
 	if (carID.length() != REQ_ID_LEN) {
-		errorMessageTemp += "Car ID must be " + to_string(REQ_ID_LEN) + " characters long ";
-		isValidLength = false;
+		return -1;
 	}
-	else {
-		for (int i{ 0 }; i < REQ_ID_LEN; i++) {
-			char c = carID[i];
-			// Check that the first requirement is satisfied
-			if (i < ID_PART1_END) {
-				if (!(c >= 'A' && c <= 'Z' && c != 'O') && validReq1 == true) {
-					errorMessageTemp += "First 2 characters of Car ID must be letters alpha only (A-Z, letter O is not allowed) ";
-					validReq1 = false;
-				}
-			} // Check that the second requirement is satisfied
-			else if (i <= ID_PART2_END && validReq2 == true) {
-				if (!((c >= 'A' && c <= 'Z' && c != 'O') || (c >= '0' && c <= '9')) && validReq2 == true) {
-					errorMessageTemp += "Characters 3-6 of Car ID must be alphanumeric (A-Z, 0-9, letter 0 is not allowed) ";
-					validReq2 = false;
-				}
-			} // Check that the final requirement is satisfied
-			else {
-				if (!(c >= '0' && c <= '9') && validReq3 == true) {
-					errorMessage += "Characters 7-9 of Car ID must be numeric ";
-					validReq3 = false;
-				}
-			}
+	EnsureIdIndex();
+	return idIndex.Find(CarID::FromString(carID).toKey(), [this](int index) { return carIDs[index].toKey(); });
+}
+
+// Collects the store indices of the records matching query into matches and returns the field whose sorted order
+// answered it (0 when no criterion was set and matches is the whole store in file order). Each constrained field's
+// cached sort order serves as a secondary index: the records in a quantity or price range, or with an ID prefix,
+// are one contiguous run of it, found by binary search. Only the shortest such run is scanned for the remaining
+// criteria, so the cost is logarithmic plus the size of that run. Matches come in that field's descending order.
+int Inventory::Query(const InventoryQuery& query, vector<int>& matches) {
+	int bestField = 0;
+	pair<int, int> bestRange{ 0, GetNumCars() };
+
+	auto consider = [&](int field, pair<int, int> range) {
+		if (bestField == 0 || range.second - range.first < bestRange.second - bestRange.first) {
+			bestField = field;
+			bestRange = range;
 		}
+	};
+	if (query.HasQuantityRange()) {
+		consider(QUANTITY, QuantityRange(query.minQuantity, query.maxQuantity));
+	}
+	if (query.HasPriceRange()) {
+		consider(PRICE, PriceRange(query.minPrice, query.maxPrice));
+	}
+	if (!query.idPrefix.empty()) {
+		consider(ID, IdPrefixRange(query.idPrefix));
 	}
 
-	if (isValidLength && validReq1 && validReq2 && validReq3) {
-		isValidID = true;
+	matches.clear();
+	const vector<int>* order = (bestField == 0) ? nullptr : &GetSortedOrder(bestField);
+	for (int i{ bestRange.first }; i < bestRange.second; i++) {
+		int index = order ? (*order)[i] : i;
+		if (MatchesQuery(index, query)) {
+			matches.push_back(index);
+		}
 	}
-	else {
-		errorMessage = "Invalid ID:    [ " + errorMessageTemp + "]";
+	return bestField;
+}
+
+// Checks every criterion of query against the record at the given store index
+bool Inventory::MatchesQuery(int index, const InventoryQuery& query) const {
+	return quantities[index] >= query.minQuantity && quantities[index] <= query.maxQuantity
+		&& prices[index] >= query.minPrice && prices[index] <= query.maxPrice
+		&& query.idPrefix.length() <= (size_t)REQ_ID_LEN && memcmp(carIDs[index].chars, query.idPrefix.data(), query.idPrefix.length()) == 0;
+}
+
+// Returns the positions [first, last) in the quantity order of the records with minQuantity <= quantity <= maxQuantity
+pair<int, int> Inventory::QuantityRange(int minQuantity, int maxQuantity) {
+	const vector<int>& order = GetSortedOrder(QUANTITY);
+	auto first = partition_point(order.begin(), order.end(), [&](int index) { return quantities[index] > maxQuantity; });
+	auto last = partition_point(first, order.end(), [&](int index) { return quantities[index] >= minQuantity; });
+	return { (int)(first - order.begin()), (int)(last - order.begin()) };
+}
+
+// Returns the positions [first, last) in the price order of the records with minPrice <= price <= maxPrice
+pair<int, int> Inventory::PriceRange(double minPrice, double maxPrice) {
+	const vector<int>& order = GetSortedOrder(PRICE);
+	auto first = partition_point(order.begin(), order.end(), [&](int index) { return prices[index] > maxPrice; });
+	auto last = partition_point(first, order.end(), [&](int index) { return prices[index] >= minPrice; });
+	return { (int)(first - order.begin()), (int)(last - order.begin()) };
+}
+
+// Returns the positions [first, last) in the ID order of the records whose ID starts with prefix. Packed keys order
+// like the IDs, so those IDs lie between the prefix padded with the lowest and with the highest character.
+pair<int, int> Inventory::IdPrefixRange(const string& prefix) {
+	const vector<int>& order = GetSortedOrder(ID);
+	if (prefix.length() > (size_t)REQ_ID_LEN) {
+		return { 0, 0 };
 	}
-	return isValidID;
+
+	CarID lowest = CarID::FromString(prefix);
+	CarID highest = lowest;
+	memset(highest.chars + prefix.length(), 0x7F, REQ_ID_LEN - prefix.length());
+	uint64_t lowKey = lowest.toKey();
+	uint64_t highKey = highest.toKey();
+
+	auto first = partition_point(order.begin(), order.end(), [&](int index) { return carIDs[index].toKey() > highKey; });
+	auto last = partition_point(first, order.end(), [&](int index) { return carIDs[index].toKey() >= lowKey; });
+	return { (int)(first - order.begin()), (int)(last - order.begin()) };
 }
 
-// Check if the model starts with a capital letter, is at least 3 characters long, and is alphanumeric
-bool Inventory::ValidateModel(string model, string& errorMessage) {
-	bool validModel = false;
-	bool validFirst = true, validLength = true, validAlphanumeric = true;
-	int length = model.length();
-	string errorMessageTemp{ "" };
+// Computes stock totals, quantity and price statistics, a price histogram and per-model totals in two passes over
+// the quantity, price and model handle columns. Each pass is a set of plain loops over contiguous arrays, and with at
+// least PARALLEL_AGGREGATE_THRESHOLD records the columns are cut into one slice per sort thread whose partial results
+// are merged in slice order. Counts and quantities are exact; value and price sums may differ in the last bits
+// between thread counts.
+InventoryAggregate Inventory::Aggregate() {
+	int numCars = GetNumCars();
+	int numThreads = (numCars >= PARALLEL_AGGREGATE_THRESHOLD) ? sortThreads : 1;
+	vector<InventoryAggregate> partials(numThreads);
+	auto sliceBegin = [&](int t) { return (int)((long long)numCars * t / numThreads); };
+
+	RunParallel(numThreads, [&](int t) {
+		ReduceColumns(quantities.data(), prices.data(), modelHandles.data(), sliceBegin(t), sliceBegin(t + 1), modelPool.GetNumModels(), partials[t]);
+	});
+
+	InventoryAggregate result;
+	for (const InventoryAggregate& partial : partials) {
+		result.Merge(partial);
+	}
+
+	// Second pass: the histogram buckets depend on the overall price range
+	double bucketWidth = (result.maxPrice - result.minPrice) / PRICE_HISTOGRAM_BUCKETS;
+	vector<vector<long long>> histograms(numThreads, vector<long long>(PRICE_HISTOGRAM_BUCKETS, 0));
+
+	RunParallel(numThreads, [&](int t) {
+		CountPrices(prices.data(), sliceBegin(t), sliceBegin(t + 1), result.minPrice, bucketWidth, histograms[t]);
+	});
+
+	result.priceHistogram.assign(PRICE_HISTOGRAM_BUCKETS, 0);
+	for (const vector<long long>& histogram : histograms) {
+		for (int b{ 0 }; b < PRICE_HISTOGRAM_BUCKETS; b++) {
+			result.priceHistogram[b] += histogram[b];
+		}
+	}
+	return result;
+}
 
-	// Check that the model meets the minimum length requirement
-	if (length < MIN_MODEL_LEN) {
-		validLength = false;
-		errorMessageTemp += "Model must be at least " + to_string(MIN_MODEL_LEN) + " characters long";
+// Adds the records [first, last) of the given columns to partial. The scalar reductions are branch-free and keep four
+// independent floating-point accumulators, so the compiler can vectorize them; the group-by indexes dense per-handle
+// arrays, numModels of them.
+void Inventory::ReduceColumns(const int* quantity, const double* price, const uint32_t* modelHandle, int first, int last,
+	int numModels, InventoryAggregate& partial) {
+	long long totalQuantity = 0;
+	long long numOutOfStock = 0;
+	int minQuantity = numeric_limits<int>::max();
+	int maxQuantity = numeric_limits<int>::min();
+	double minPrice = numeric_limits<double>::infinity();
+	double maxPrice = -numeric_limits<double>::infinity();
+	double value[4] = { 0, 0, 0, 0 };
+	double priceSum[4] = { 0, 0, 0, 0 };
+
+	if (partial.modelTotals.size() < (size_t)numModels) {
+		partial.modelTotals.resize(numModels);
 	}
-	else {
-		// Check that the model starts with a capital letter that isn't O
-		if (model[0] < 'A' || model[0] > 'Z' || model[0] == 'O') {
-			validFirst = false;
-			errorMessageTemp += "Model must start with a capital letter (A-Z, letter O is not allowed) ";
+	ModelTotals* modelTotals = partial.modelTotals.data();
+
+	for (int blockBegin{ first }; blockBegin < last; blockBegin += AGGREGATE_BLOCK_RECORDS) {
+		int blockEnd = (int)min<long long>((long long)blockBegin + AGGREGATE_BLOCK_RECORDS, last);
+
+		for (int i{ blockBegin }; i < blockEnd; i++) {
+			totalQuantity += quantity[i];
+			numOutOfStock += (quantity[i] == 0);
+			minQuantity = min(minQuantity, quantity[i]);
+			maxQuantity = max(maxQuantity, quantity[i]);
+			minPrice = min(minPrice, price[i]);
+			maxPrice = max(maxPrice, price[i]);
 		}
-		else {
-			for (int i{ 1 }; i < length; i++) {
-				char c = model[i];
 
-				if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) && validAlphanumeric) {
-					errorMessageTemp += "Model must must be alphanumeric (A-Z, 0-9, letter 0 is not allowed) ";
-					validAlphanumeric = false;
-				}
+		int i{ blockBegin };
+		for (; i + 4 <= blockEnd; i += 4) {
+			for (int lane{ 0 }; lane < 4; lane++) {
+				value[lane] += quantity[i + lane] * price[i + lane];
+				priceSum[lane] += price[i + lane];
 			}
 		}
+		for (; i < blockEnd; i++) {
+			value[0] += quantity[i] * price[i];
+			priceSum[0] += price[i];
+		}
+
+		for (int r{ blockBegin }; r < blockEnd; r++) {
+			ModelTotals& totals = modelTotals[modelHandle[r]];
+			totals.numCars++;
+			totals.quantity += quantity[r];
+			totals.value += quantity[r] * price[r];
+		}
 	}
 
-	if (validFirst && validLength && validAlphanumeric) {
-		validModel = true;
+	partial.numCars += last - first;
+	partial.totalQuantity += totalQuantity;
+	partial.numOutOfStock += numOutOfStock;
+	partial.totalValue += (value[0] + value[1]) + (value[2] + value[3]);
+	partial.priceSum += (priceSum[0] + priceSum[1]) + (priceSum[2] + priceSum[3]);
+	partial.minQuantity = min(partial.minQuantity, minQuantity);
+	partial.maxQuantity = max(partial.maxQuantity, maxQuantity);
+	partial.minPrice = min(partial.minPrice, minPrice);
+	partial.maxPrice = max(partial.maxPrice, maxPrice);
+}
+
+// Adds the prices of the records [first, last) to equal-width buckets starting at minPrice; the maximum price (and
+// any rounding past the end) lands in the last bucket. Consecutive records count into separate copies of the
+// histogram so runs of similar prices do not serialize on one counter.
+void Inventory::CountPrices(const double* price, int first, int last, double minPrice, double bucketWidth, vector<long long>& histogram) {
+	double bucketsPerUnit = (bucketWidth > 0) ? 1 / bucketWidth : 0;
+	long long counts[4][PRICE_HISTOGRAM_BUCKETS] = {};
+
+	for (int i{ first }; i < last; i++) {
+		int bucket = (int)((price[i] - minPrice) * bucketsPerUnit);
+		counts[i & 3][min(bucket, PRICE_HISTOGRAM_BUCKETS - 1)]++;
 	}
-	else {
-		errorMessage = "Invalid Model: [ " + errorMessageTemp + "] ";
+	for (int b{ 0 }; b < PRICE_HISTOGRAM_BUCKETS; b++) {
+		histogram[b] += (counts[0][b] + counts[1][b]) + (counts[2][b] + counts[3][b]);
 	}
-	return validModel;
 }
 
-// Check if the quantity is greater than or equal to 0
-bool Inventory::ValidateQuantity(int quantity, string& errorMessage) {
-	bool validQuantity = false;
+// Folds another slice's partial results into this one
+void InventoryAggregate::Merge(const InventoryAggregate& other) {
+	numCars += other.numCars;
+	totalQuantity += other.totalQuantity;
+	numOutOfStock += other.numOutOfStock;
+	totalValue += other.totalValue;
+	priceSum += other.priceSum;
+	minQuantity = min(minQuantity, other.minQuantity);
+	maxQuantity = max(maxQuantity, other.maxQuantity);
+	minPrice = min(minPrice, other.minPrice);
+	maxPrice = max(maxPrice, other.maxPrice);
+
+	modelTotals.resize(max(modelTotals.size(), other.modelTotals.size()));
+	for (size_t m{ 0 }; m < other.modelTotals.size(); m++) {
+		modelTotals[m].numCars += other.modelTotals[m].numCars;
+		modelTotals[m].quantity += other.modelTotals[m].quantity;
+		modelTotals[m].value += other.modelTotals[m].value;
+	}
+}
 
-	if (quantity >= 0) {
-		validQuantity = true;
+// Finishes background work, commits the journal and frees every version that was published. Readers must not
+// outlive the inventory.
+Inventory::~Inventory() {
+	WaitForCompaction();
+	journal.reset();
+	WaitForErrorFile();
+	for (const auto& [epoch, version] : retiredVersions) {
+		delete version;
 	}
-	else {
-		errorMessage += "Invalid Quant: [ Quantity must be greater than or equal to 0 ] ";
+	delete publishedVersion.load();
+}
+
+// Notes that the record at index changed, so the next Publish copies its segment instead of sharing it
+void Inventory::MarkDirty(int index) {
+	size_t segment = index / VERSION_SEGMENT_RECORDS;
+	if (segment >= dirtySegments.size()) {
+		dirtySegments.resize(segment + 1, false);
 	}
-	return validQuantity;
+	dirtySegments[segment] = true;
 }
 
-// Check if the price is greater than MIN_PRICE
-bool Inventory::ValidatePrice(double price, string& errorMessage) {
-	bool validPrice = false;
+// Makes the current store the version that InventoryReader objects see from their next Refresh on. Segments without
+// changes since the previous version are shared with it, so publishing costs a copy of the changed and appended
+// segments only; a batch of changes published together becomes visible to readers all at once. Like every other
+// modifying member, this must only be called from the writer thread.
+void Inventory::Publish() {
+	const InventoryVersion* previous = publishedVersion.load();
+	bool share = (previous != nullptr) && !republishAll;
+	int numCars = GetNumCars();
+	int numSegments = (numCars + VERSION_SEGMENT_RECORDS - 1) / VERSION_SEGMENT_RECORDS;
+	InventoryVersion* version = new InventoryVersion();
+
+	version->number = (previous != nullptr) ? previous->number + 1 : 1;
+	version->numCars = numCars;
+	version->segments.resize(numSegments);
+	for (int s{ 0 }; s < numSegments; s++) {
+		int first = s * VERSION_SEGMENT_RECORDS;
+		int count = min(VERSION_SEGMENT_RECORDS, numCars - first);
+		bool dirty = (s < (int)dirtySegments.size()) && dirtySegments[s];
+
+		if (share && !dirty && first + count <= previous->numCars) {
+			version->segments[s] = previous->segments[s];
+			continue;
+		}
+		shared_ptr<ColumnSegment> segment = make_shared<ColumnSegment>();
+		copy_n(carIDs.begin() + first, count, segment->carIDs);
+		copy_n(modelHandles.begin() + first, count, segment->modelHandles);
+		copy_n(quantities.begin() + first, count, segment->quantities);
+		copy_n(prices.begin() + first, count, segment->prices);
+		version->segments[s] = move(segment);
+	}
 
-	if (price > MIN_PRICE) {
-		validPrice = true;
+	// The model pool only grows between clears, so an unchanged size means unchanged names
+	if (share && previous->models->GetNumModels() == modelPool.GetNumModels()) {
+		version->models = previous->models;
+		version->modelRanks = previous->modelRanks;
 	}
 	else {
-		errorMessage += "Invalid Price: [ Price must be greater than $5000 ]";
+		shared_ptr<ModelPool> models = make_shared<ModelPool>();
+		for (uint32_t h{ 0 }; h < (uint32_t)modelPool.GetNumModels(); h++) {
+			models->Intern(modelPool.GetName(h));
+		}
+		version->models = move(models);
+		version->modelRanks = make_shared<const vector<uint32_t>>(modelPool.GetRanks());
+	}
+
+	fill(dirtySegments.begin(), dirtySegments.end(), false);
+	republishAll = false;
+	publishedVersion.store(version);
+	if (previous != nullptr) {
+		retiredVersions.push_back({ readEpoch.fetch_add(1), previous });
 	}
-	return validPrice;
+	ReclaimVersions();
 }
 
-// Sorts the inventory by user-specified field in descending order
-void Inventory::SortBy(int field) {
-	Car* temp;
+// Frees the replaced versions no reader can still hold. A reader holds at most the version that was published when
+// it announced its epoch, and a version replaced in epoch e was already unpublished by the time the epoch moved past
+// e, so it is safe to free once every active reader has announced an epoch after e.
+void Inventory::ReclaimVersions() {
+	uint64_t oldestEpoch = numeric_limits<uint64_t>::max();
+	for (const ReaderSlot& slot : readerSlots) {
+		uint64_t epoch = slot.epoch.load();
+		if (epoch != 0) {
+			oldestEpoch = min(oldestEpoch, epoch);
+		}
+	}
+
+	auto unreachable = [oldestEpoch](const pair<uint64_t, const InventoryVersion*>& retired) {
+		if (retired.first >= oldestEpoch) {
+			return false;
+		}
+		delete retired.second;
+		return true;
+	};
+	retiredVersions.erase(remove_if(retiredVersions.begin(), retiredVersions.end(), unreachable), retiredVersions.end());
+}
+
+// Claims a free reader slot (waiting for one if all MAX_INVENTORY_READERS are taken) and reads the published version
+InventoryReader::InventoryReader(Inventory& n_inventory) : inventory(n_inventory), slot(0) {
+	for (;; this_thread::yield()) {
+		for (slot = 0; slot < MAX_INVENTORY_READERS; slot++) {
+			bool inUse = false;
+			if (inventory.readerSlots[slot].inUse.compare_exchange_strong(inUse, true)) {
+				Refresh();
+				return;
+			}
+		}
+	}
+}
+
+InventoryReader::~InventoryReader() {
+	inventory.readerSlots[slot].epoch.store(0);
+	inventory.readerSlots[slot].inUse.store(false);
+}
+
+// Moves on to the latest published version. The epoch is announced before the version is read, so the writer
+// cannot free the version this reader is about to hold.
+void InventoryReader::Refresh() {
+	inventory.readerSlots[slot].epoch.store(inventory.readEpoch.load());
+	version = inventory.publishedVersion.load();
+}
+
+// Materializes a record of this reader's version as a Car
+Car InventoryReader::GetCar(int index) const {
+	const ColumnSegment& segment = SegmentOf(index);
+	int i = index % VERSION_SEGMENT_RECORDS;
+	return Car(segment.carIDs[i], segment.modelHandles[i], segment.quantities[i], segment.prices[i], version->models.get());
+}
+
+// Aggregates this reader's version like Inventory::Aggregate, one segment at a time on the calling thread
+InventoryAggregate InventoryReader::Aggregate() const {
+	InventoryAggregate result;
+	int numCars = GetNumCars();
+	int numModels = (version != nullptr) ? version->models->GetNumModels() : 0;
+	auto segmentSize = [numCars](int s) { return min(VERSION_SEGMENT_RECORDS, numCars - s * VERSION_SEGMENT_RECORDS); };
+
+	result.modelTotals.resize(numModels);
+	result.priceHistogram.assign(PRICE_HISTOGRAM_BUCKETS, 0);
+	if (numCars == 0) {
+		return result;
+	}
+
+	int numSegments = (int)version->segments.size();
+	for (int s{ 0 }; s < numSegments; s++) {
+		const ColumnSegment& segment = *version->segments[s];
+		Inventory::ReduceColumns(segment.quantities, segment.prices, segment.modelHandles, 0, segmentSize(s), numModels, result);
+	}
+
+	double bucketWidth = (result.maxPrice - result.minPrice) / PRICE_HISTOGRAM_BUCKETS;
+	for (int s{ 0 }; s < numSegments; s++) {
+		Inventory::CountPrices(version->segments[s]->prices, 0, segmentSize(s), result.minPrice, bucketWidth, result.priceHistogram);
+	}
+	return result;
+}
+
+// Fills order with the indices of this reader's version in descending order of a field, ties in index order, as
+// Inventory::SortBy would order the same records
+void InventoryReader::SortBy(int field, vector<int>& order) const {
+	int numCars = GetNumCars();
+
+	auto sortBy = [&](auto keyOf) {
+		vector<KeyedIndex<decltype(keyOf(0))>> items(numCars);
+		for (int i{ 0 }; i < numCars; i++) {
+			items[i] = { keyOf(i), i };
+		}
+		RadixSort(items);
+		order.resize(numCars);
+		for (int i{ 0 }; i < numCars; i++) {
+			order[i] = items[i].index;
+		}
+	};
+	auto at = [this](int index) { return index % VERSION_SEGMENT_RECORDS; };
+
+	switch (field) {
+	case ID:
+		sortBy([&](int i) { return ~SegmentOf(i).carIDs[at(i)].toKey(); });
+		break;
+	case MODEL:
+		sortBy([&](int i) { return ~(*version->modelRanks)[SegmentOf(i).modelHandles[at(i)]]; });
+		break;
+	case QUANTITY:
+		sortBy([&](int i) { return Inventory::QuantityKey(SegmentOf(i).quantities[at(i)]); });
+		break;
+	case PRICE:
+		sortBy([&](int i) { return Inventory::PriceKey(SegmentOf(i).prices[at(i)]); });
+		break;
+	default:
+		order.clear();
+		break;
+	}
+}
+
+// Replays the journal named by files.journalFileName on top of the loaded store and opens it for the changes to come:
+// first its base file, the net changes of every compacted entry, then the journal entries after those. A torn entry
+// at the end of the journal, left by a crash during a write, ends the replay and is cut off. Entries for car IDs the
+// store does not hold, or that no longer fit its quantities, are skipped. A damaged base file, or a journal that starts after what its base includes, means
+// changes are missing and ends the program.
+void Inventory::OpenJournal() {
+	const string& journalFileName = files.journalFileName;
+	string baseFileName{ journalFileName + JOURNAL_BASE_SUFFIX };
+	uint64_t baseSequence = 0;
+	uint64_t firstSequence = 0;
+	uint64_t nextSequence = 0;
+	long long numSkipped = 0;
+	vector<JournalEntry> entries;
+	JournalHeader header;
+	bool torn;
+	error_code error;
+
+	if (journalFileName.empty()) {
+		return;
+	}
+
+	// The base file is replaced whole, so unlike the journal it must read back completely
+	uintmax_t baseFileSize = filesystem::file_size(baseFileName, error);
+	if (!error && baseFileSize > 0) {
+		if (!ReadJournalFile(baseFileName, JOURNAL_BASE_MAGIC, header, entries, torn) || torn) {
+			cerr << "ERROR: '" << baseFileName << "' is damaged or not a journal base this program can read. Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+		baseSequence = firstSequence = nextSequence = header.baseSequence;
+		for (const JournalEntry& entry : entries) {
+			numSkipped += !ApplyJournalEntry(entry);
+		}
+	}
+
+	// An empty file is one whose header never reached the disk; it is written again below
+	uintmax_t journalFileSize = filesystem::file_size(journalFileName, error);
+	if (!error && journalFileSize > 0) {
+		if (!ReadJournalFile(journalFileName, JOURNAL_MAGIC, header, entries, torn)) {
+			cerr << "ERROR: '" << journalFileName << "' is not a journal this program can read. Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+		if (header.firstSequence > baseSequence) {
+			cerr << "ERROR: '" << journalFileName << "' starts at change " << header.firstSequence << " but '" << baseFileName
+				<< "' only includes the changes before " << baseSequence << ". Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+
+		firstSequence = header.firstSequence;
+		nextSequence = firstSequence + entries.size();
+		if (nextSequence < baseSequence) {
+			// Everything the journal holds is in the base already, so a new journal starts after the base
+			filesystem::remove(journalFileName, error);
+			firstSequence = nextSequence = baseSequence;
+		}
+		else {
+			for (size_t e{ (size_t)(baseSequence - firstSequence) }; e < entries.size(); e++) {
+				numSkipped += !ApplyJournalEntry(entries[e]);
+			}
+			if (torn) {
+				filesystem::resize_file(journalFileName, sizeof(JournalHeader) + entries.size() * sizeof(JournalEntry), error);
+			}
+		}
+	}
+
+	if (numSkipped > 0) {
+		cerr << "NOTE: Skipped " << numSkipped << " journal entries for car IDs that are not in the inventory or that would make a quantity invalid\n";
+	}
+	journal = make_unique<Journal>(journalFileName, firstSequence, nextSequence);
+}
+
+// Applies one replayed journal entry to the store; returns false if its car ID is not in the store or, once Data.txt
+// has changed under the journal, its delta would make the quantity invalid
+bool Inventory::ApplyJournalEntry(const JournalEntry& entry) {
+	int index = FindCar(string_view(entry.carID.chars, REQ_ID_LEN));
+	if (index < 0) {
+		return false;
+	}
+
+	switch (entry.kind) {
+	case QUANTITY_DELTA:
+		return AdjustQuantity(index, entry.quantity);
+	case QUANTITY_SET:
+		SetQuantity(index, entry.quantity);
+		break;
+	case PRICE_SET:
+		SetPrice(index, entry.price);
+		break;
+	}
+	return true;
+}
+
+// Waits until every change made so far is on disk; with a group commit pending this forces it to start at once
+void Inventory::WaitForJournal() {
+	if (journal != nullptr) {
+		journal->Sync();
+	}
+}
+
+// Folds the journal into its base file on a background thread (see Journal::Compact); changes go on meanwhile.
+// Does nothing without a journal.
+void Inventory::CompactJournal() {
+	if (journal == nullptr) {
+		return;
+	}
+
+	WaitForCompaction();
+	journalCompaction = async(launch::async, [this]() {
+		journal->Compact();
+	});
+}
+
+// Blocks until a background compaction, if one is running, has finished
+void Inventory::WaitForCompaction() {
+	if (journalCompaction.valid()) {
+		journalCompaction.get();
+	}
+}
+
+// Opens the journal file for appending, creating it with a header starting at firstSequence if it does not exist,
+// and starts the committer. The caller has already replayed and validated any existing entries.
+Journal::Journal(const string& n_fileName, uint64_t n_firstSequence, uint64_t n_nextSequence)
+	: fileName(n_fileName), baseFileName(n_fileName + JOURNAL_BASE_SUFFIX), firstSequence(n_firstSequence), nextSequence(n_nextSequence),
+	durableSequence(n_nextSequence) {
+	OpenFile();
+	committer = thread([this]() { CommitLoop(); });
+}
+
+// Commits whatever is still queued and closes the file
+Journal::~Journal() {
+	{
+		lock_guard<mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueSignal.notify_one();
+	committer.join();
+	fclose(file);
+}
+
+// Opens fileName for appending, writing a header first if the file is new or empty
+void Journal::OpenFile() {
+	error_code error;
+	uintmax_t fileSize = filesystem::file_size(fileName, error);
+
+	file = fopen(fileName.c_str(), "ab");
+	if (file == nullptr) {
+		cerr << "ERROR: Unable to open '" << fileName << "'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+	if ((error || fileSize == 0) && (!WriteHeader(file, JOURNAL_MAGIC, firstSequence, 0) || !SyncDirectoryOf(fileName))) {
+		cerr << "ERROR: Unable to write '" << fileName << "'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Queues a change, giving it the next sequence number. Only waits when JOURNAL_MAX_QUEUED changes are already
+// waiting for the disk.
+void Journal::Append(JournalEntry entry) {
+	unique_lock<mutex> lock(queueMutex);
+	durableSignal.wait(lock, [this]() { return queued.size() < JOURNAL_MAX_QUEUED; });
+
+	entry.sequence = nextSequence++;
+	entry.checksum = JournalChecksum(entry);
+	queued.push_back(entry);
+	if (queued.size() >= JOURNAL_GROUP_ENTRIES) {
+		queueSignal.notify_one();
+	}
+}
+
+// Waits until every change appended so far is on disk; returns the sequence the next change will get
+uint64_t Journal::Sync() {
+	unique_lock<mutex> lock(queueMutex);
+	uint64_t target = nextSequence;
+
+	if (durableSequence < target) {
+		syncRequested = true;
+		queueSignal.notify_one();
+		durableSignal.wait(lock, [&]() { return durableSequence >= target; });
+	}
+	return target;
+}
+
+long long Journal::GetNumSyncs() {
+	lock_guard<mutex> lock(queueMutex);
+	return numSyncs;
+}
+
+// Group commit: waits up to JOURNAL_COMMIT_INTERVAL_MS for changes to gather, then writes and syncs all of them at
+// once while new changes queue up behind
+void Journal::CommitLoop() {
+	vector<JournalEntry> batch;
+	unique_lock<mutex> lock(queueMutex);
+
+	while (!stopping || !queued.empty()) {
+		queueSignal.wait_for(lock, chrono::milliseconds(JOURNAL_COMMIT_INTERVAL_MS),
+			[this]() { return stopping || syncRequested || queued.size() >= JOURNAL_GROUP_ENTRIES; });
+		syncRequested = false;
+		if (queued.empty()) {
+			continue;
+		}
+
+		batch.swap(queued);
+		lock.unlock();
+		WriteEntries(batch);
+		lock.lock();
+
+		durableSequence = batch.back().sequence + 1;
+		numSyncs++;
+		batch.clear();
+		durableSignal.notify_all();
+	}
+}
+
+// Appends entries to the file with one write and makes them durable with one sync
+void Journal::WriteEntries(const vector<JournalEntry>& entries) {
+	lock_guard<mutex> lock(fileMutex);
+
+	if (fwrite(entries.data(), sizeof(JournalEntry), entries.size(), file) != entries.size() || fflush(file) != 0 || !SyncFile(file)) {
+		cerr << "ERROR: Unable to write '" << fileName << "'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Folds every change on disk so far into a new base file, then restarts the journal after them, so it only grows
+// with the changes since. The base holds one net change per car: its quantity set with the later deltas applied, or
+// the sum of its deltas, and its last price. The base is complete and synced before it replaces the old one, and
+// the journal is cut only after that; replay skips journal entries the base already includes, so a crash at any
+// point loses nothing. Returns false if nothing was compacted.
+bool Journal::Compact() {
+	uint64_t sequence = Sync();
+	uint64_t baseSequence = 0;
+	vector<JournalEntry> changes, entries;
+	JournalHeader header;
+	bool torn;
+	error_code error;
+
+	uintmax_t baseFileSize = filesystem::file_size(baseFileName, error);
+	if (!error && baseFileSize > 0) {
+		if (!ReadJournalFile(baseFileName, JOURNAL_BASE_MAGIC, header, changes, torn) || torn) {
+			return false;
+		}
+		baseSequence = header.baseSequence;
+	}
+
+	// Entries before sequence are on disk and never change; later ones may be mid-write and are left alone
+	if (!ReadJournalFile(fileName, JOURNAL_MAGIC, header, entries, torn) || header.firstSequence > baseSequence
+		|| header.firstSequence + entries.size() < sequence) {
+		return false;
+	}
+	if (sequence <= baseSequence) {
+		return true;
+	}
+	changes.insert(changes.end(), entries.begin() + (size_t)(baseSequence - header.firstSequence),
+		entries.begin() + (size_t)(sequence - header.firstSequence));
+	FoldJournalEntries(changes);
+
+	string tempFileName{ baseFileName + ".tmp" };
+	FILE* base = fopen(tempFileName.c_str(), "wb");
+	if (base == nullptr) {
+		return false;
+	}
+	bool written = WriteHeader(base, JOURNAL_BASE_MAGIC, 0, sequence)
+		&& (changes.empty() || fwrite(changes.data(), sizeof(JournalEntry), changes.size(), base) == changes.size())
+		&& fflush(base) == 0 && SyncFile(base);
+	fclose(base);
+	if (written) {
+		filesystem::rename(tempFileName, baseFileName, error);
+	}
+	if (!written || error) {
+		filesystem::remove(tempFileName, error);
+		return false;
+	}
+
+	// Only a base that is sure to survive a crash may stand in for the entries the journal drops
+	if (!SyncDirectoryOf(baseFileName)) {
+		return false;
+	}
+	Rebase(sequence);
+	return true;
+}
+
+// Replaces the file with one that starts at newFirstSequence, once the base file includes every earlier entry. The
+// new file is complete and synced before it replaces the old one, so after a crash either file is whole.
+void Journal::Rebase(uint64_t newFirstSequence) {
+	Sync();
+	lock_guard<mutex> lock(fileMutex);
+	string tempFileName{ fileName + ".tmp" };
+	error_code error;
+
+	// Entries committed since the Sync are in the file as well; every entry from newFirstSequence on is kept
+	uintmax_t fileSize = filesystem::file_size(fileName, error);
+	size_t numEntries = error ? 0 : (size_t)((fileSize - sizeof(JournalHeader)) / sizeof(JournalEntry));
+	size_t numDropped = (size_t)min<uint64_t>(newFirstSequence - firstSequence, numEntries);
+	vector<JournalEntry> kept(numEntries - numDropped);
+
+	ifstream oldFile(fileName, ios::binary);
+	oldFile.seekg(sizeof(JournalHeader) + numDropped * sizeof(JournalEntry));
+	oldFile.read(reinterpret_cast<char*>(kept.data()), kept.size() * sizeof(JournalEntry));
+	if (error || !oldFile) {
+		return; // Keep the old file; replay skips the entries the base already includes
+	}
+	oldFile.close();
+
+	FILE* rebased = fopen(tempFileName.c_str(), "wb");
+	if (rebased == nullptr) {
+		return;
+	}
+	bool written = WriteHeader(rebased, JOURNAL_MAGIC, newFirstSequence, 0)
+		&& (kept.empty() || fwrite(kept.data(), sizeof(JournalEntry), kept.size(), rebased) == kept.size()) && fflush(rebased) == 0 && SyncFile(rebased);
+	fclose(rebased);
+	if (!written) {
+		filesystem::remove(tempFileName, error);
+		return;
+	}
+
+	fclose(file);
+	filesystem::rename(tempFileName, fileName, error);
+	if (!error) {
+		firstSequence = newFirstSequence;
+		SyncDirectoryOf(fileName);
+	}
+	OpenFile();
+}
+
+// Writes a journal or base file header (as magic says) at the start of a new file and makes it durable
+bool Journal::WriteHeader(FILE* file, const char* magic, uint64_t firstSequence, uint64_t baseSequence) {
+	JournalHeader header{};
+	memcpy(header.magic, magic, sizeof(header.magic));
+	header.version = JOURNAL_VERSION;
+	header.byteOrder = SNAPSHOT_BYTE_ORDER;
+	header.entryBytes = sizeof(JournalEntry);
+	header.firstSequence = firstSequence;
+	header.baseSequence = baseSequence;
+	return fwrite(&header, sizeof(header), 1, file) == 1 && fflush(file) == 0 && SyncFile(file);
+}
+
+// Forces a file's written data to the disk
+bool Journal::SyncFile(FILE* file) {
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Makes a file written through a stream durable, by opening it again and syncing it
+bool SyncFileName(const string& fileName) {
+	FILE* file = fopen(fileName.c_str(), "r+b");
+	if (file == nullptr) {
+		return false;
+	}
+	bool synced = Journal::SyncFile(file);
+	fclose(file);
+	return synced;
+}
+
+// Makes the entries of the directory holding fileName durable, so a file just created or renamed there survives a
+// crash under its new name. NTFS logs renames itself, so there is nothing to do on Windows.
+bool SyncDirectoryOf(const string& fileName) {
+#ifdef _WIN32
+	(void)fileName;
+	return true;
+#else
+	filesystem::path directory = filesystem::path(fileName).parent_path();
+	int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	bool synced = fsync(fd) == 0;
+	close(fd);
+	return synced;
+#endif
+}
+
+// Checksum of a journal entry's bytes before its checksum field
+uint64_t JournalChecksum(const JournalEntry& entry) {
+	return Checksum64(reinterpret_cast<const char*>(&entry), offsetof(JournalEntry, checksum), JOURNAL_VERSION);
+}
+
+// Reads a journal or base file whose header carries magic: the header, then the entries up to the first one that is
+// torn, fails its checksum or is out of sequence. torn tells whether anything followed them. Returns false if the
+// file cannot be read or its header does not match.
+bool ReadJournalFile(const string& fileName, const char* magic, JournalHeader& header, vector<JournalEntry>& entries, bool& torn) {
+	MappedFile journalFile;
+
+	entries.clear();
+	if (!journalFile.Open(fileName) || journalFile.getSize() < sizeof(JournalHeader)) {
+		return false;
+	}
+	memcpy(&header, journalFile.getData(), sizeof(JournalHeader));
+	if (memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != JOURNAL_VERSION
+		|| header.byteOrder != SNAPSHOT_BYTE_ORDER || header.entryBytes != sizeof(JournalEntry)) {
+		return false;
+	}
+
+	size_t numEntries = (journalFile.getSize() - sizeof(JournalHeader)) / sizeof(JournalEntry);
+	const char* entryData = journalFile.getData() + sizeof(JournalHeader);
+	for (size_t e{ 0 }; e < numEntries; e++) {
+		JournalEntry entry;
+		memcpy(&entry, entryData + e * sizeof(JournalEntry), sizeof(JournalEntry));
+		if (entry.sequence != header.firstSequence + e || entry.checksum != JournalChecksum(entry)) {
+			break;
+		}
+		entries.push_back(entry);
+	}
+	torn = journalFile.getSize() != sizeof(JournalHeader) + entries.size() * sizeof(JournalEntry);
+	return true;
+}
+
+// Folds a run of journal entries, in the order they were made, into the net change per car: a quantity set with the
+// deltas after it applied, or the sum of the deltas, then the last price set. The result is in car ID order and
+// numbered from 0, ready for a base file.
+void FoldJournalEntries(vector<JournalEntry>& entries) {
+	vector<JournalEntry> folded;
+
+	stable_sort(entries.begin(), entries.end(), [](const JournalEntry& a, const JournalEntry& b) {
+		return memcmp(a.carID.chars, b.carID.chars, REQ_ID_LEN) < 0;
+	});
+	for (size_t first{ 0 }, last; first < entries.size(); first = last) {
+		bool quantitySet = false;
+		bool priceSet = false;
+		long long quantity = 0;
+		double price = 0;
+
+		for (last = first; last < entries.size() && memcmp(entries[last].carID.chars, entries[first].carID.chars, REQ_ID_LEN) == 0; last++) {
+			const JournalEntry& entry = entries[last];
+			switch (entry.kind) {
+			case QUANTITY_DELTA:
+				quantity += entry.quantity;
+				break;
+			case QUANTITY_SET:
+				quantitySet = true;
+				quantity = entry.quantity;
+				break;
+			case PRICE_SET:
+				priceSet = true;
+				price = entry.price;
+				break;
+			}
+		}
+
+		JournalEntry change{};
+		change.carID = entries[first].carID;
+		if (quantitySet || quantity != 0) {
+			change.kind = (uint8_t)(quantitySet ? QUANTITY_SET : QUANTITY_DELTA);
+			change.quantity = (int32_t)clamp<long long>(quantity, numeric_limits<int32_t>::min(), numeric_limits<int32_t>::max());
+			folded.push_back(change);
+		}
+		if (priceSet) {
+			change.kind = PRICE_SET;
+			change.quantity = 0;
+			change.price = price;
+			folded.push_back(change);
+		}
+	}
+
+	for (size_t e{ 0 }; e < folded.size(); e++) {
+		folded[e].sequence = e;
+		folded[e].checksum = JournalChecksum(folded[e]);
+	}
+	entries.swap(folded);
+}
+
+// Describes the criteria that are set, e.g. "quantity 0 to 0, ID prefix AB12"
+string InventoryQuery::toString() const {
+	ostringstream description;
+	string separator{ "" };
+
+	description << fixed << setprecision(2);
+	if (HasQuantityRange()) {
+		description << "quantity " << minQuantity << " to " << maxQuantity;
+		separator = ", ";
+	}
+	if (HasPriceRange()) {
+		description << separator << "price " << minPrice << " to " << maxPrice;
+		separator = ", ";
+	}
+	if (!idPrefix.empty()) {
+		description << separator << "ID prefix " << idPrefix;
+	}
+	return HasCriteria() ? description.str() : "all records";
+}
+
+// Materializes the record at the given store index as a Car
+Car Inventory::GetCar(int index) const {
+	return Car(carIDs[index], modelHandles[index], quantities[index], prices[index], &modelPool);
+}
+
+// Mixes the packed key so both the top bits (slot) and the low bits (tag) depend on every ID character
+uint64_t IdIndex::Hash(uint64_t key) {
+	uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+	hash ^= hash >> 31;
+	return hash * 0xBF58476D1CE4E5B9ull;
+}
+
+// Returns the index stored for key, or -1
+template <typename KeyFunction>
+int IdIndex::Find(uint64_t key, KeyFunction keyOf) const {
+	if (slots.empty()) {
+		return -1;
+	}
+
+	uint64_t hash = Hash(key);
+	size_t mask = slots.size() - 1;
+	for (size_t slot = (size_t)(hash >> shift); ; slot = (slot + 1) & mask) {
+		const Slot& entry = slots[slot];
+		if (entry.index < 0) {
+			return -1;
+		}
+		if (entry.tag == (uint32_t)hash && keyOf(entry.index) == key) {
+			return entry.index;
+		}
+	}
+}
+
+// Adds key -> index unless key is already present. Returns the index already stored for key, or -1 if it was added.
+template <typename KeyFunction>
+int IdIndex::Insert(uint64_t key, int index, KeyFunction keyOf) {
+	if ((size_t)(numEntries + 1) * 100 > slots.size() * ID_INDEX_MAX_LOAD_PERCENT) {
+		Rehash(max<size_t>(ID_INDEX_MIN_SLOTS, slots.size() * 2), keyOf);
+	}
+
+	uint64_t hash = Hash(key);
+	size_t mask = slots.size() - 1;
+	for (size_t slot = (size_t)(hash >> shift); ; slot = (slot + 1) & mask) {
+		Slot& entry = slots[slot];
+		if (entry.index < 0) {
+			entry = { (uint32_t)hash, index };
+			numEntries++;
+			return -1;
+		}
+		if (entry.tag == (uint32_t)hash && keyOf(entry.index) == key) {
+			return entry.index;
+		}
+	}
+}
+
+// Sizes the slot table for count entries up front, so bulk loads do not rehash repeatedly
+template <typename KeyFunction>
+void IdIndex::Reserve(int count, KeyFunction keyOf) {
+	size_t numSlots = ID_INDEX_MIN_SLOTS;
+	while ((size_t)count * 100 > numSlots * ID_INDEX_MAX_LOAD_PERCENT) {
+		numSlots *= 2;
+	}
+	if (numSlots > slots.size()) {
+		Rehash(numSlots, keyOf);
+	}
+}
+
+// Moves every entry into a new table of numSlots slots (a power of 2), recovering each key through keyOf
+template <typename KeyFunction>
+void IdIndex::Rehash(size_t numSlots, KeyFunction keyOf) {
+	vector<Slot> oldSlots(numSlots, Slot{ 0, -1 });
+	oldSlots.swap(slots);
+
+	shift = 64;
+	for (size_t n{ numSlots }; n > 1; n >>= 1) {
+		shift--;
+	}
+
+	size_t mask = numSlots - 1;
+	for (const Slot& entry : oldSlots) {
+		if (entry.index >= 0) {
+			size_t slot = (size_t)(Hash(keyOf(entry.index)) >> shift);
+			while (slots[slot].index >= 0) {
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = entry;
+		}
+	}
+}
+
+// Empties the index but keeps its slot table, so reloading a feed of the same size does not reallocate it
+void IdIndex::Clear() {
+	fill(slots.begin(), slots.end(), Slot{ 0, -1 });
+	numEntries = 0;
+}
+
+bool MappedFile::Open(const string& fileName) {
+	Close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize)) {
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	if (size > 0) {
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr) {
+			Close();
+			return false;
+		}
+		data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr) {
+			Close();
+			return false;
+		}
+	}
+#else
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat fileInfo;
+	if (fstat(fd, &fileInfo) != 0) {
+		close(fd);
+		return false;
+	}
+	size = (size_t)fileInfo.st_size;
+
+	if (size > 0) {
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			close(fd);
+			size = 0;
+			return false;
+		}
+		madvise(mapping, size, MADV_SEQUENTIAL);
+		data = static_cast<const char*>(mapping);
+	}
+	close(fd); // The mapping stays valid after the descriptor is closed
+#endif
+	return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data != nullptr) {
+		munmap(const_cast<char*>(data), size);
+	}
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+// Right-justifies the characters in digits[0, length) in a field of the given width
+void RowWriter::AppendRightJustified(const char* digits, int length, int width) {
+	Reserve(max(length, width));
+	for (int i{ length }; i < width; i++) {
+		buffer[used++] = ' ';
+	}
+	memcpy(&buffer[used], digits, length);
+	used += length;
+}
+
+// Left-justifies text in a field of the given width; like setw, longer text is written in full
+void RowWriter::AppendText(string_view text, int width) {
+	int length = (int)text.length();
+
+	Reserve(max(length, width));
+	memcpy(&buffer[used], text.data(), length);
+	used += length;
+	for (int i{ length }; i < width; i++) {
+		buffer[used++] = ' ';
+	}
+}
+
+void RowWriter::AppendInt(long long value, int width) {
+	char digits[24];
+	int pos = sizeof(digits);
+	unsigned long long magnitude = (value < 0) ? 0ull - (unsigned long long)value : (unsigned long long)value;
+
+	do {
+		digits[--pos] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+	if (value < 0) {
+		digits[--pos] = '-';
+	}
+	AppendRightJustified(digits + pos, (int)sizeof(digits) - pos, width);
+}
+
+// Formats value with 2 decimals, matching 'fixed << setprecision(2)'. Values are scaled to integer cents; when the
+// scaled value lies too close to a rounding boundary, or is negative, huge or not finite, snprintf does the rounding.
+void RowWriter::AppendFixed(double value, int width) {
+	char digits[32];
+	double cents = value * 100.0;
+	double fraction = cents - floor(cents);
+
+	if (signbit(value) || !(value < 1e9) || fabs(fraction - 0.5) < 1e-3) {
+		int length = snprintf(digits, sizeof(digits), "%.2f", value);
+		if (length < 0 || length >= (int)sizeof(digits)) {
+			ostringstream formatted;
+			formatted << fixed << setprecision(2) << value;
+			string text = formatted.str();
+			AppendRightJustified(text.data(), (int)text.length(), width);
+		}
+		else {
+			AppendRightJustified(digits, length, width);
+		}
+		return;
+	}
+
+	unsigned long long wholeCents = (unsigned long long)(cents + 0.5);
+	int pos = sizeof(digits);
+
+	digits[--pos] = (char)('0' + wholeCents % 10);
+	digits[--pos] = (char)('0' + wholeCents / 10 % 10);
+	digits[--pos] = '.';
+	wholeCents /= 100;
+	do {
+		digits[--pos] = (char)('0' + wholeCents % 10);
+		wholeCents /= 10;
+	} while (wholeCents != 0);
+	AppendRightJustified(digits + pos, (int)sizeof(digits) - pos, width);
+}
+
+void RowWriter::AppendChar(char c) {
+	Reserve(1);
+	buffer[used++] = c;
+}
+
+// Appends one inventory row in the Car::toString layout
+void RowWriter::AppendRecord(const CarID& carID, string_view model, int quantity, double price) {
+	AppendText(string_view(carID.chars, REQ_ID_LEN), TEXT_WIDTH);
+	AppendText(model, TEXT_WIDTH);
+	AppendInt(quantity, NUM_WIDTH);
+	AppendFixed(price, NUM_WIDTH);
+	AppendChar('\n');
+}
+
+// Makes room for count more bytes, flushing first if they do not fit
+void RowWriter::Reserve(size_t count) {
+	if (used + count > buffer.size()) {
+		Flush();
+		if (count > buffer.size()) {
+			buffer.resize(count);
+		}
+	}
+}
+
+void RowWriter::Flush() {
+	if (used > 0) {
+		out.write(buffer.data(), used);
+		used = 0;
+	}
+	out.flush();
+}
+
+void LineScanner::SkipWhitespace() {
+	while (pos < end && isspace(static_cast<unsigned char>(*pos))) {
+		pos++;
+	}
+}
+
+LineScanner& LineScanner::operator>>(string_view& token) {
+	SkipWhitespace();
+	if (failed || pos == end) {
+		failed = true;
+		return *this;
+	}
+
+	const char* start = pos;
+	while (pos < end && !isspace(static_cast<unsigned char>(*pos))) {
+		pos++;
+	}
+	token = string_view(start, pos - start);
+	return *this;
+}
+
+// Like the stream extractor, a failed conversion stores 0 and an out-of-range one saturates
+LineScanner& LineScanner::operator>>(int& value) {
+	SkipWhitespace();
+	if (failed) {
+		return *this;
+	}
+
+	const char* start = pos;
+	if (start < end && *start == '+' && start + 1 < end && *(start + 1) != '-') {
+		start++; // from_chars does not accept an explicit plus sign
+	}
+
+	from_chars_result result = from_chars(start, end, value);
+	if (result.ec == errc::result_out_of_range) {
+		value = (*start == '-') ? numeric_limits<int>::min() : numeric_limits<int>::max();
+		failed = true;
+	}
+	else if (result.ec != errc()) {
+		value = 0;
+		failed = true;
+	}
+	pos = result.ptr;
+	return *this;
+}
+
+LineScanner& LineScanner::operator>>(double& value) {
+	SkipWhitespace();
+	if (failed) {
+		return *this;
+	}
+
+	const char* start = pos;
+	if (start < end && (*start == '+' || *start == '-')) {
+		start++;
+	}
+	// Only plain decimal notation is accepted, which rules out the "inf" and "nan" spellings from_chars would take
+	if (start == end || !(isdigit(static_cast<unsigned char>(*start)) || *start == '.')) {
+		value = 0;
+		failed = true;
+		return *this;
+	}
+	if (*pos == '+') {
+		pos++;
+	}
+
+	// A value outside the range of double reads as 0 on every parse path, so the record fails the price rule
+	from_chars_result result = from_chars(pos, end, value);
+	if (result.ec != errc()) {
+		value = 0;
+		failed = true;
+	}
+	else {
+		pos = result.ptr;
+	}
+	return *this;
+}
+
+// Copies up to REQ_ID_LEN characters of id, padding a shorter id with NULs
+CarID CarID::FromString(string_view id) {
+	CarID carID{};
+	memcpy(carID.chars, id.data(), min<size_t>(id.length(), REQ_ID_LEN));
+	return carID;
+}
+
+// Packs the ID into 63 bits, 7 per character, so integer order matches character order for ASCII IDs
+uint64_t CarID::toKey() const {
+	static_assert(REQ_ID_LEN * 7 <= 64, "Packed Car ID keys hold at most 9 characters");
+
+	uint64_t key = 0;
+	for (int i{ 0 }; i < REQ_ID_LEN; i++) {
+		key = (key << 7) | (uint64_t)(chars[i] & 0x7F);
+	}
+	return key;
+}
+
+string Car::toString() const {
+	stringstream recordString;
+	recordString << fixed << showpoint << setprecision(2) << left << setw(TEXT_WIDTH) << carID.toString() << setw(TEXT_WIDTH) << getModel()
+		<< setw(NUM_WIDTH) << right << quantity << setw(NUM_WIDTH) << price << left << endl;
+
+	return recordString.str();
+}
+
+// Feeds are only ever parsed: a snapshot describes a single data file
+void Inventory::ParseData() {
+	bool sharded = !files.feedFileNames.empty();
+
+	if (sharded) {
+		ParseFeeds((parseMode == PARALLEL_PARSE) ? max(1, (int)thread::hardware_concurrency()) : 1);
+		return;
+	}
+	if (useSnapshot && LoadSnapshot()) {
+		const string& errorFileName = files.errorFileName;
+		ofstream Errfile;
+
+		cout << fixed << showpoint << setprecision(2);
+		if (writeErrorFile) {
+			Errfile.open(errorFileName);
+			if (!Errfile) {
+				cerr << "ERROR: Unable to open '" << errorFileName << "'. Terminating Program\n";
+				exit(EXIT_FAILURE);
+			}
+		}
+		FlushErrorFile(move(Errfile));
+		return;
+	}
+
+	if (parseMode == PARALLEL_PARSE) {
+		ParseMappedData(max(1, (int)thread::hardware_concurrency()));
+	}
+	else if (parseMode == MAPPED_PARSE) {
+		ParseMappedData(1);
+	}
+	else {
+		ParseStreamData();
+	}
+
+	if (useSnapshot) {
+		WriteSnapshot();
+	}
+}
+
+// Loads the validated inventory and error store from Inventory.snapshot. The snapshot is only used when it was
+// built from the current Data.txt (same size and modification time) by a compatible build with the same duplicate
+// policy, and its checksum matches;
+// otherwise this returns false and leaves the inventory empty. Each section is copied straight into its column;
+// only the distinct model names are re-interned.
+bool Inventory::LoadSnapshot() {
+	const string& fileName = files.dataFileName;
+	const string& snapshotFileName = files.snapshotFileName;
+	MappedFile snapshot;
+	SnapshotHeader header;
+	error_code error;
+
+	uintmax_t dataFileSize = filesystem::file_size(fileName, error);
+	if (error) {
+		return false;
+	}
+	filesystem::file_time_type dataFileTime = filesystem::last_write_time(fileName, error);
+	if (error) {
+		return false;
+	}
+
+	if (!snapshot.Open(snapshotFileName) || snapshot.getSize() < sizeof(SnapshotHeader)) {
+		return false;
+	}
+	memcpy(&header, snapshot.getData(), sizeof(SnapshotHeader));
+
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version != SNAPSHOT_VERSION
+		|| header.byteOrder != SNAPSHOT_BYTE_ORDER || header.idLength != (uint32_t)REQ_ID_LEN
+		|| header.rejectedRecordBytes != sizeof(RejectedRecord) || header.duplicatePolicy != (uint32_t)duplicatePolicy
+		|| header.dataFileSize != (int64_t)dataFileSize
+		|| header.dataFileTime != (int64_t)dataFileTime.time_since_epoch().count()) {
+		return false;
+	}
+
+	// Bound every count by the file size before multiplying, so a damaged header cannot overflow the layout math
+	size_t payloadBytes = snapshot.getSize() - sizeof(SnapshotHeader);
+	if (header.numCars > payloadBytes || header.numModels > header.numCars || header.modelTextBytes > payloadBytes
+		|| header.numRejected > payloadBytes || header.rejectedTextBytes > payloadBytes) {
+		return false;
+	}
+
+	size_t numCars = header.numCars;
+	size_t numModels = header.numModels;
+	size_t numRejected = header.numRejected;
+	size_t sectionBytes[] = { numCars * sizeof(CarID), numCars * sizeof(int), numCars * sizeof(double), numCars * sizeof(uint32_t),
+		(numModels + 1) * sizeof(uint64_t), header.modelTextBytes, numRejected * sizeof(RejectedRecord), header.rejectedTextBytes };
+	size_t expectedBytes = 0;
+	for (size_t bytes : sectionBytes) {
+		expectedBytes += (bytes + 7) & ~(size_t)7;
+	}
+	if (expectedBytes != payloadBytes) {
+		return false;
+	}
+
+	// Hash each section and then its padding, the same pieces WriteSnapshot hashed
+	uint64_t checksum = SNAPSHOT_VERSION;
+	const char* sectionBegin = snapshot.getData() + sizeof(SnapshotHeader);
+	for (size_t bytes : sectionBytes) {
+		checksum = Checksum64(sectionBegin, bytes, checksum);
+		checksum = Checksum64(sectionBegin + bytes, (8 - bytes % 8) % 8, checksum);
+		sectionBegin += (bytes + 7) & ~(size_t)7;
+	}
+	if (checksum != header.checksum) {
+		return false;
+	}
+
+	const char* pos = snapshot.getData() + sizeof(SnapshotHeader);
+	int section = 0;
+	auto nextSection = [&]() {
+		const char* sectionBegin = pos;
+		pos += (sectionBytes[section++] + 7) & ~(size_t)7;
+		return sectionBegin;
+	};
+	auto readColumn = [&](auto& column, size_t count) {
+		column.resize(count);
+		memcpy(column.data(), nextSection(), count * sizeof(column[0]));
+	};
+
+	vector<uint64_t> modelOffsets;
+
+	readColumn(carIDs, numCars);
+	readColumn(quantities, numCars);
+	readColumn(prices, numCars);
+	readColumn(modelHandles, numCars);
+	readColumn(modelOffsets, numModels + 1);
+	const char* modelText = nextSection();
+
+	// Re-interning the names in handle order into the empty pool gives every name its saved handle back
+	for (size_t m{ 0 }; m < numModels; m++) {
+		if (modelOffsets[m] > modelOffsets[m + 1] || modelOffsets[m + 1] > header.modelTextBytes
+			|| modelPool.Intern(string_view(modelText + modelOffsets[m], modelOffsets[m + 1] - modelOffsets[m])) != m) {
+			Clear();
+			return false;
+		}
+	}
+	for (size_t i{ 0 }; i < numCars; i++) {
+		if (modelHandles[i] >= numModels) {
+			Clear();
+			return false;
+		}
+	}
+
+	readColumn(rejectedRecords, numRejected);
+	rejectedText.assign(nextSection(), header.rejectedTextBytes);
+	numLines = header.numLines;
+	consumedBytes = header.consumedBytes;
+	numDuplicates = header.numDuplicates;
+
+	// The snapshot holds the record of an unterminated last line; the line itself is read back from the data file
+	if (consumedBytes < 0 || consumedBytes > header.dataFileSize) {
+		Clear();
+		return false;
+	}
+	pendingLine.assign(header.dataFileSize - consumedBytes, '\0');
+	if (!pendingLine.empty()) {
+		ifstream dataFile(fileName, ios::binary);
+		dataFile.seekg(consumedBytes);
+		dataFile.read(&pendingLine[0], pendingLine.size());
+		if (!dataFile || pendingLine.find('\n') != string::npos) {
+			Clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+// Writes the validated inventory and error store to Inventory.snapshot, through a temporary file that replaces the
+// old snapshot only once it is complete and synced. The model pool is saved as its names in handle order.
+// A failure to write is not an error: the next start simply parses Data.txt again.
+void Inventory::WriteSnapshot() {
+	const string& fileName = files.dataFileName;
+	const string& snapshotFileName = files.snapshotFileName;
+	string tempFileName{ snapshotFileName + ".tmp" };
+	error_code error;
+
+	uintmax_t dataFileSize = filesystem::file_size(fileName, error);
+	if (error || (int64_t)dataFileSize != consumedBytes + (int64_t)pendingLine.size()) {
+		return; // Data.txt changed while it was being parsed
+	}
+	filesystem::file_time_type dataFileTime = filesystem::last_write_time(fileName, error);
+	if (error) {
+		return;
+	}
+
+	int numCars = GetNumCars();
+	vector<uint64_t> modelOffsets{ 0 };
+	string modelText;
+
+	for (int m{ 0 }; m < modelPool.GetNumModels(); m++) {
+		modelText += modelPool.GetName(m);
+		modelOffsets.push_back(modelText.size());
+	}
+
+	SnapshotHeader header{};
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version = SNAPSHOT_VERSION;
+	header.byteOrder = SNAPSHOT_BYTE_ORDER;
+	header.idLength = REQ_ID_LEN;
+	header.rejectedRecordBytes = sizeof(RejectedRecord);
+	header.duplicatePolicy = duplicatePolicy;
+	header.numCars = numCars;
+	header.numModels = modelOffsets.size() - 1;
+	header.modelTextBytes = modelText.size();
+	header.numRejected = rejectedRecords.size();
+	header.rejectedTextBytes = rejectedText.size();
+	header.numLines = numLines;
+	header.consumedBytes = consumedBytes;
+	header.numDuplicates = numDuplicates;
+	header.dataFileSize = dataFileSize;
+	header.dataFileTime = dataFileTime.time_since_epoch().count();
+
+	const pair<const void*, size_t> sections[] = {
+		{ carIDs.data(), numCars * sizeof(CarID) }, { quantities.data(), numCars * sizeof(int) },
+		{ prices.data(), numCars * sizeof(double) }, { modelHandles.data(), numCars * sizeof(uint32_t) },
+		{ modelOffsets.data(), modelOffsets.size() * sizeof(uint64_t) }, { modelText.data(), modelText.size() },
+		{ rejectedRecords.data(), rejectedRecords.size() * sizeof(RejectedRecord) }, { rejectedText.data(), rejectedText.size() } };
+	const char padding[8] = {};
+
+	header.checksum = SNAPSHOT_VERSION;
+	for (const auto& section : sections) {
+		header.checksum = Checksum64(static_cast<const char*>(section.first), section.second, header.checksum);
+		header.checksum = Checksum64(padding, (8 - section.second % 8) % 8, header.checksum);
+	}
+
+	ofstream snapshotFile(tempFileName, ios::binary | ios::trunc);
+	if (!snapshotFile) {
+		return;
+	}
+	snapshotFile.write(reinterpret_cast<const char*>(&header), sizeof(SnapshotHeader));
+	for (const auto& section : sections) {
+		snapshotFile.write(static_cast<const char*>(section.first), section.second);
+		snapshotFile.write(padding, (8 - section.second % 8) % 8);
+	}
+	snapshotFile.close();
+
+	if (!snapshotFile || !SyncFileName(tempFileName)) {
+		filesystem::remove(tempFileName, error);
+		return;
+	}
+	filesystem::rename(tempFileName, snapshotFileName, error);
+	if (!error) {
+		SyncDirectoryOf(snapshotFileName);
+	}
+}
+
+// Reads the data file line by line through getline, tokenizing each line in place. The line and model buffers are
+// reused across lines, so no memory is allocated per record once they have grown to the longest line.
+void Inventory::ParseStreamData() {
+	const string& fileName = files.dataFileName;
+	const string& errorFileName = files.errorFileName;
+	stringstream ssHeader;
+
+	cout << fixed << showpoint << setprecision(2);
+	ssHeader << fixed << showpoint << setprecision(2) << left
+		<< setw(TEXT_WIDTH) << "Vehicle ID"
+		<< setw(TEXT_WIDTH) << "Model"
+		<< setw(NUM_WIDTH) << right << "Quantity"
+		<< setw(NUM_WIDTH) << "Price" << left << "\n\n";
+
+	ifstream Infile(fileName);
+	if (!Infile.is_open()) {
+		cerr << "ERROR: Unable to open '" << fileName << "'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+	else if (Infile.peek() == EOF) {
+		cerr << "ERROR: '" << fileName << "' is empty. No data to process. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+
+	ofstream Errfile;
+	if (writeErrorFile) {
+		Errfile.open(errorFileName);
+		if (!Errfile) {
+			cerr << "ERROR: Unable to open '" << errorFileName << "'. Terminating Program\n";
+			Infile.close();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Pre-size the record store from the file size so large feeds don't trigger repeated regrowth
+	Infile.seekg(0, ios::end);
+	streamoff fileSize = Infile.tellg();
+	Infile.seekg(0, ios::beg);
+	Reserve((int)min<streamoff>(fileSize / EST_RECORD_BYTES + 1, numeric_limits<int>::max()));
+
+	unsigned failedRules;
+	string line, model;
+
+	while (getline(Infile, line)) {
+		// Fields are reset per line so a malformed line never reports values left over from the previous one
+		string_view carIDView, modelView;
+		int quantity{ 0 };
+		double price{ 0 };
+
+		LineScanner scanner(line.data(), line.data() + line.length());
+		scanner >> carIDView >> modelView >> quantity >> price;
+		numLines++;
+		if (Infile.eof()) {
+			pendingLine = line; // getline only stops at the end of the file when the last line has no newline
+		}
+
+		failedRules = ValidateRecord(carIDView, modelView, quantity, price);
+
+		if (failedRules == 0) {
+			// A valid ID only holds digits and capital letters, so only the model needs case conversion
+			model.assign(modelView);
+			MakeStringUppercase(model);
+
+			CarID id = CarID::FromString(carIDView);
+			AddRecord(id, id.toKey(), modelPool.Intern(model), quantity, price);
+		}
+		else {
+			AddRejectedRecord(line.data(), line.data() + line.length(), failedRules);
+		}
+	}
+
+	Infile.close();
+	consumedBytes = fileSize - (streamoff)pendingLine.size();
+	FlushErrorFile(move(Errfile));
+}
+
+// Maps the data file and tokenizes each line in place; strings are only materialized for records that pass validation.
+// The file is cut into newline-aligned chunks that are parsed on up to numThreads workers and merged back in file order,
+// so the record order and the error store do not depend on the thread count.
+void Inventory::ParseMappedData(int numThreads) {
+	const string& fileName = files.dataFileName;
+	const string& errorFileName = files.errorFileName;
+	MappedFile dataFile;
+
+	cout << fixed << showpoint << setprecision(2);
+
+	if (!dataFile.Open(fileName)) {
+		cerr << "ERROR: Unable to open '" << fileName << "'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+	else if (dataFile.getSize() == 0) {
+		cerr << "ERROR: '" << fileName << "' is empty. No data to process. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+
+	ofstream Errfile;
+	if (writeErrorFile) {
+		Errfile.open(errorFileName);
+		if (!Errfile) {
+			cerr << "ERROR: Unable to open '" << errorFileName << "'. Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	Reserve((int)min<size_t>(dataFile.getSize() / EST_RECORD_BYTES + 1, numeric_limits<int>::max()));
+
+	const char* data = dataFile.getData();
+	const char* end = data + dataFile.getSize();
+	const char* pendingBegin = end;
+	while (pendingBegin > data && *(pendingBegin - 1) != '\n') {
+		pendingBegin--;
+	}
+
+	ParseRange(data, end, numThreads);
+	pendingLine.assign(pendingBegin, end);
+	consumedBytes = pendingBegin - data;
+	FlushErrorFile(move(Errfile));
+}
+
+// Parses the lines in [data, end) and appends them to the store in order, on up to numThreads workers
+void Inventory::ParseRange(const char* data, const char* end, int numThreads) {
+	// Cut the range into chunks, moving each nominal boundary forward to the start of the next line
+	vector<ParsedChunk> chunks;
+	const char* chunkBegin = data;
+
+	while (chunkBegin < end) {
+		const char* chunkEnd = end;
+		if ((size_t)(end - chunkBegin) > PARSE_CHUNK_BYTES) {
+			const char* newline = static_cast<const char*>(memchr(chunkBegin + PARSE_CHUNK_BYTES, '\n', end - chunkBegin - PARSE_CHUNK_BYTES));
+			chunkEnd = (newline == nullptr) ? end : newline + 1;
+		}
+		chunks.emplace_back();
+		chunks.back().begin = chunkBegin;
+		chunks.back().end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	RunPipelined((int)chunks.size(), numThreads, [&](int i) { ParseChunk(chunks[i]); }, [&](int i) { AppendChunk(chunks[i]); });
+}
+
+// Loads every file of files.feedFileNames as a shard. Each feed is mapped and parsed whole on its own worker (and
+// sorted by files.feedSortField if one is set) while this thread appends finished shards in feed order, so duplicate
+// car IDs resolve across feeds exactly as if the feeds were one concatenated file, and the load takes about as long
+// as the slowest feed plus the appends. Empty feeds are allowed; missing ones end the program.
+void Inventory::ParseFeeds(int numThreads) {
+	const vector<string>& feedFileNames = files.feedFileNames;
+	const string& errorFileName = files.errorFileName;
+	int numShards = (int)feedFileNames.size();
+	vector<FeedShard> shards(numShards);
+	uintmax_t totalBytes = 0;
+	int failedFeed = -1; // First feed that could not be mapped
+
+	cout << fixed << showpoint << setprecision(2);
+
+	// Every feed must open before any worker starts, so a missing feed never ends the program mid-pipeline
+	for (const string& fileName : feedFileNames) {
+		error_code error;
+		uintmax_t fileSize = filesystem::file_size(fileName, error);
+		if (error || !ifstream(fileName).is_open()) {
+			cerr << "ERROR: Unable to open '" << fileName << "'. Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+		totalBytes += fileSize;
+	}
+
+	ofstream Errfile;
+	if (writeErrorFile) {
+		Errfile.open(errorFileName);
+		if (!Errfile) {
+			cerr << "ERROR: Unable to open '" << errorFileName << "'. Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	Reserve((int)min<uintmax_t>(totalBytes / EST_RECORD_BYTES + 1, numeric_limits<int>::max()));
+
+	RunPipelined(numShards, numThreads, [&](int i) {
+		MappedFile feed;
+		FeedShard& shard = shards[i];
+
+		shard.opened = feed.Open(feedFileNames[i]);
+		if (shard.opened) {
+			shard.chunk.begin = feed.getData();
+			shard.chunk.end = feed.getData() + feed.getSize();
+			ParseChunk(shard.chunk);
+			shard.chunk.begin = shard.chunk.end = nullptr;
+			if (files.feedSortField != 0) {
+				SortShard(shard, files.feedSortField);
+			}
+		}
+	}, [&](int i) {
+		if (!shards[i].opened) {
+			failedFeed = (failedFeed < 0) ? i : failedFeed;
+			return;
+		}
+		AppendChunk(shards[i].chunk, &shards[i].storeIndices);
+	});
+
+	// A feed that vanished after the check above is reported once the workers have finished
+	if (failedFeed >= 0) {
+		cerr << "ERROR: Unable to open '" << feedFileNames[failedFeed] << "'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+
+	if (files.feedSortField != 0) {
+		MergeShardOrders(shards, files.feedSortField);
+	}
+	consumedBytes = (long long)totalBytes;
+	FlushErrorFile(move(Errfile));
+}
+
+// Sorts a parsed shard's records by a field, by (key, chunk index) like SortByKey. Shard-local model handles are
+// ranked within the shard's own pool; name order is the same in every pool, so the shard orders stay mergeable.
+void Inventory::SortShard(FeedShard& shard, int field) {
+	const ParsedChunk& chunk = shard.chunk;
+	int count = (int)chunk.quantities.size();
+
+	auto sortBy = [&](auto keyOf) {
+		vector<KeyedIndex<decltype(keyOf(0))>> items(count);
+		for (int i{ 0 }; i < count; i++) {
+			items[i] = { keyOf(i), i };
+		}
+		RadixSort(items);
+		shard.order.resize(count);
+		for (int i{ 0 }; i < count; i++) {
+			shard.order[i] = items[i].index;
+		}
+	};
+
+	switch (field) {
+	case ID:
+		sortBy([&](int i) { return ~chunk.idKeys[i]; });
+		break;
+	case MODEL: {
+		const vector<uint32_t>& ranks = shard.chunk.modelPool.GetRanks();
+		sortBy([&](int i) { return ~ranks[chunk.modelHandles[i]]; });
+		break;
+	}
+	case QUANTITY:
+		sortBy([&](int i) { return QuantityKey(chunk.quantities[i]); });
+		break;
+	case PRICE:
+		sortBy([&](int i) { return PriceKey(chunk.prices[i]); });
+		break;
+	}
+}
+
+// Builds the cached order of a field from the sorted shards with a k-way merge instead of a full sort. Appended
+// shard records keep their relative store order, so each shard order maps to a sorted run of store indices. Records
+// whose key a later duplicate changed (KEEP_LAST, or SUM_QUANTITIES for quantity) are taken out of their runs and
+// merged in as one extra run sorted by their final keys.
+void Inventory::MergeShardOrders(vector<FeedShard>& shards, int field) {
+	bool keysChange = (duplicatePolicy == KEEP_LAST && field != ID) || (duplicatePolicy == SUM_QUANTITIES && field == QUANTITY);
+	vector<char> changed(GetNumCars(), false);
+	vector<vector<int>> runs;
+	vector<int> changedRun;
+
+	if (keysChange) {
+		for (const FeedShard& shard : shards) {
+			for (int storeIndex : shard.storeIndices) {
+				if (storeIndex < 0 && !changed[-1 - storeIndex]) {
+					changed[-1 - storeIndex] = true;
+					changedRun.push_back(-1 - storeIndex);
+				}
+			}
+		}
+	}
+
+	for (FeedShard& shard : shards) {
+		runs.emplace_back();
+		runs.back().reserve(shard.order.size());
+		for (int chunkIndex : shard.order) {
+			int storeIndex = shard.storeIndices[chunkIndex];
+			if (storeIndex >= 0 && !changed[storeIndex]) {
+				runs.back().push_back(storeIndex);
+			}
+		}
+		vector<int>().swap(shard.order);
+		vector<int>().swap(shard.storeIndices);
+	}
+	if (!changedRun.empty()) {
+		OrderBy(field, changedRun, changedRun.size());
+		runs.push_back(move(changedRun));
+	}
+
+	vector<int>& order = fieldOrders[field];
+	switch (field) {
+	case ID:
+		MergeRuns<uint64_t>([this](int i) { return IdSortKey(i); }, runs, order);
+		break;
+	case MODEL: {
+		const vector<uint32_t>& ranks = modelPool.GetRanks();
+		MergeRuns<uint32_t>([this, &ranks](int i) { return ModelSortKey(i, ranks); }, runs, order);
+		break;
+	}
+	case QUANTITY:
+		MergeRuns<uint32_t>([this](int i) { return QuantitySortKey(i); }, runs, order);
+		break;
+	case PRICE:
+		MergeRuns<uint64_t>([this](int i) { return PriceSortKey(i); }, runs, order);
+		break;
+	}
+}
+
+// Merges runs of store indices, each sorted by (key, index), into order with a heap holding the head of every run
+template <typename Key, typename KeyFunction>
+void Inventory::MergeRuns(KeyFunction keyOf, vector<vector<int>>& runs, vector<int>& order) {
+	// The heap keeps the smallest head on top, so its comparison is the reverse of (key, index) order
+	auto greater = [](const pair<KeyedIndex<Key>, int>& a, const pair<KeyedIndex<Key>, int>& b) {
+		return a.first.key > b.first.key || (a.first.key == b.first.key && a.first.index > b.first.index);
+	};
+	vector<pair<KeyedIndex<Key>, int>> heads; // (head item, run)
+	vector<size_t> next(runs.size(), 1);
+
+	order.clear();
+	order.reserve(GetNumCars());
+	for (int r{ 0 }; r < (int)runs.size(); r++) {
+		if (!runs[r].empty()) {
+			heads.push_back({ { keyOf(runs[r][0]), runs[r][0] }, r });
+		}
+	}
+	make_heap(heads.begin(), heads.end(), greater);
+
+	while (!heads.empty()) {
+		pop_heap(heads.begin(), heads.end(), greater);
+		auto& [head, r] = heads.back();
+		order.push_back(head.index);
+
+		if (next[r] < runs[r].size()) {
+			int index = runs[r][next[r]++];
+			head = { keyOf(index), index };
+			push_heap(heads.begin(), heads.end(), greater);
+		}
+		else {
+			heads.pop_back();
+		}
+	}
+}
+
+// Parses and validates every line in [chunk.begin, chunk.end), keeping valid records and rejected lines in the chunk.
+// Rejected lines are only recorded with their failed validator bits; no message text is built during ingestion.
+void Inventory::ParseChunk(ParsedChunk& chunk) {
+	string model;
+
+	TakeSpareChunk(chunk);
+	const char* pos = chunk.begin;
+	chunk.carIDs.reserve((chunk.end - chunk.begin) / EST_RECORD_BYTES + 1);
+	chunk.idKeys.reserve(chunk.carIDs.capacity());
+	chunk.modelHandles.reserve(chunk.carIDs.capacity());
+	chunk.quantities.reserve(chunk.carIDs.capacity());
+	chunk.prices.reserve(chunk.carIDs.capacity());
+
+	while (pos < chunk.end) {
+		const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', chunk.end - pos));
+		if (lineEnd == nullptr) {
+			lineEnd = chunk.end;
+		}
+
+		string_view carIDView, modelView;
+		int quantity{ 0 };
+		double price{ 0 };
+
+		LineScanner scanner(pos, lineEnd);
+		scanner >> carIDView >> modelView >> quantity >> price;
+		chunk.numLines++;
+
+		unsigned failedRules = ValidateRecord(carIDView, modelView, quantity, price);
+		if (failedRules == 0) {
+			// A valid ID only holds digits and capital letters, so only the model needs case conversion
+			model.assign(modelView);
+			MakeStringUppercase(model);
+
+			chunk.carIDs.push_back(CarID::FromString(carIDView));
+			chunk.idKeys.push_back(chunk.carIDs.back().toKey());
+			chunk.modelHandles.push_back(chunk.modelPool.Intern(model));
+			chunk.quantities.push_back(quantity);
+			chunk.prices.push_back(price);
+		}
+		else {
+			chunk.rejectedRecords.push_back({ chunk.numLines, chunk.rejectedText.size(), (unsigned)(lineEnd - pos), failedRules });
+			chunk.rejectedText.append(pos, lineEnd);
+		}
+		pos = lineEnd + 1;
+	}
+}
+
+// Adds a parsed chunk's records to the store in order and recycles the chunk's buffers. If storeIndices is given it
+// receives where each record went, as for FeedShard::storeIndices.
+void Inventory::AppendChunk(ParsedChunk& chunk, vector<int>* storeIndices) {
+	// Translate the chunk's model handles into handles of the inventory's pool
+	handleMap.resize(chunk.modelPool.GetNumModels());
+	for (uint32_t h{ 0 }; h < handleMap.size(); h++) {
+		handleMap[h] = modelPool.Intern(chunk.modelPool.GetName(h));
+	}
+
+	if (storeIndices != nullptr) {
+		storeIndices->resize(chunk.carIDs.size());
+	}
+	for (size_t i{ 0 }; i < chunk.carIDs.size(); i++) {
+		int numCars = GetNumCars();
+		int storeIndex = AddRecord(chunk.carIDs[i], chunk.idKeys[i], handleMap[chunk.modelHandles[i]], chunk.quantities[i], chunk.prices[i]);
+		if (storeIndices != nullptr) {
+			(*storeIndices)[i] = (GetNumCars() > numCars) ? storeIndex : -1 - storeIndex;
+		}
+	}
+
+	for (const RejectedRecord& record : chunk.rejectedRecords) {
+		rejectedRecords.push_back({ numLines + record.lineNumber, rejectedText.size() + record.textOffset, record.textLength, record.failedRules });
+	}
+	rejectedText += chunk.rejectedText;
+	numLines += chunk.numLines;
+
+	RecycleChunk(chunk);
+}
+
+// Gives an empty chunk the buffers of a recycled one, if there is any, keeping the chunk's line range
+void Inventory::TakeSpareChunk(ParsedChunk& chunk) {
+	lock_guard<mutex> lock(spareChunksMutex);
+	if (spareChunks.empty()) {
+		return;
+	}
+
+	const char* begin = chunk.begin;
+	const char* end = chunk.end;
+	chunk = move(spareChunks.back());
+	spareChunks.pop_back();
+	chunk.begin = begin;
+	chunk.end = end;
+}
+
+// Empties an appended chunk and keeps its buffers, arena blocks included, for the next chunk to be parsed
+void Inventory::RecycleChunk(ParsedChunk& chunk) {
+	ParsedChunk spare = move(chunk);
+	spare.begin = spare.end = nullptr;
+	spare.numLines = 0;
+	spare.carIDs.clear();
+	spare.idKeys.clear();
+	spare.modelHandles.clear();
+	spare.quantities.clear();
+	spare.prices.clear();
+	spare.modelPool.Clear();
+	spare.rejectedRecords.clear();
+	spare.rejectedText.clear();
+	chunk = ParsedChunk();
+
+	lock_guard<mutex> lock(spareChunksMutex);
+	spareChunks.push_back(move(spare));
+}
+
+// Adds a rejected line of the data file to the error store
+void Inventory::AddRejectedRecord(const char* lineBegin, const char* lineEnd, unsigned failedRules) {
+	rejectedRecords.push_back({ numLines, rejectedText.size(), (unsigned)(lineEnd - lineBegin), failedRules });
+	rejectedText.append(lineBegin, lineEnd);
+}
+
+// Reads the lines appended to the data file since the last parse and merges them into the store; cached sort
+// orders pick the new records up incrementally the next time they are used. Only complete lines are consumed, so a
+// line that is still being written stays in the file until its newline arrives. A file smaller than what was already
+// consumed was truncated or replaced, and is then reloaded from the start. So is a file whose unterminated last line
+// was loaded and has since grown into a different line. Returns the number of lines consumed.
+long long Inventory::IngestAppended() {
+	const string& fileName = files.dataFileName;
+	const string& errorFileName = files.errorFileName;
+
+	// A missing file (e.g. mid-rotation) is not an error here; the next poll tries again
+	ifstream Infile(fileName, ios::binary);
+	if (!Infile.is_open()) {
+		return 0;
+	}
+	Infile.seekg(0, ios::end);
+	long long fileSize = Infile.tellg();
+
+	long long pendingEnd = consumedBytes + (long long)pendingLine.size();
+	bool reload = fileSize < pendingEnd;
+	if (reload) {
+		cout << "NOTE: '" << fileName << "' shrank. Reloading it from the start\n";
+		Clear();
+	}
+	else if (!pendingLine.empty() && fileSize > pendingEnd) {
+		// The loaded last line counts as consumed only if it was complete and just lacked its newline
+		char next{ 0 };
+		string current(pendingLine.size(), '\0');
+		Infile.seekg(consumedBytes);
+		Infile.read(&current[0], current.size());
+		Infile.get(next);
+		if (Infile && current == pendingLine && next == '\n') {
+			consumedBytes = pendingEnd + 1;
+			pendingLine.clear();
+		}
+		else {
+			cout << "NOTE: The last line of '" << fileName << "' changed after it was loaded. Reloading it from the start\n";
+			Clear();
+			reload = true;
+		}
+		Infile.clear();
+	}
+	if (fileSize <= consumedBytes) {
+		return 0;
+	}
+
+	string appended(fileSize - consumedBytes, '\0');
+	Infile.seekg(consumedBytes);
+	Infile.read(&appended[0], appended.size());
+	appended.resize(Infile.gcount());
+
+	size_t lineEnd = appended.rfind('\n');
+	if (lineEnd == string::npos) {
+		return 0;
+	}
+
+	// The previous error file write reads the error store, so it must finish before the store grows
+	WaitForErrorFile();
+	size_t firstRejected = rejectedRecords.size();
+	long long firstLine = numLines;
+
+	ParseRange(appended.data(), appended.data() + lineEnd + 1, (parseMode == PARALLEL_PARSE) ? max(1, (int)thread::hardware_concurrency()) : 1);
+	consumedBytes += lineEnd + 1;
+
+	if (writeErrorFile) {
+		ofstream Errfile(errorFileName, reload ? ios::trunc : ios::app);
+		if (!Errfile) {
+			cerr << "ERROR: Unable to open '" << errorFileName << "'. Terminating Program\n";
+			exit(EXIT_FAILURE);
+		}
+		FlushErrorFile(move(Errfile), firstRejected);
+	}
+
+	// Once readers are in use, they see appended lines as soon as they are ingested
+	if (publishedVersion.load() != nullptr) {
+		Publish();
+	}
+	return numLines - firstLine;
+}
+
+// Empties the record store, the cached sort orders and the error store
+void Inventory::Clear() {
+	WaitForErrorFile();
+	carIDs.clear();
+	modelHandles.clear();
+	modelPool.Clear();
+	idIndex.Clear();
+	numIndexed = 0;
+	numDuplicates = 0;
+	quantities.clear();
+	prices.clear();
+	for (vector<int>& order : fieldOrders) {
+		order.clear();
+	}
+	rejectedRecords.clear();
+	rejectedText.clear();
+	numLines = 0;
+	consumedBytes = 0;
+	pendingLine.clear();
+	dirtySegments.clear();
+	republishAll = true;
+}
+
+// Writes the error store from firstRecord on to Errfile on a background thread, in batches of about ERROR_BATCH_BYTES.
+// Does nothing when the error file is disabled (Errfile not open).
+void Inventory::FlushErrorFile(ofstream&& Errfile, size_t firstRecord) {
+	if (!Errfile.is_open()) {
+		return;
+	}
+
+	WaitForErrorFile();
+	errorFileFlush = async(launch::async, [this, firstRecord](ofstream file) {
+		ostringstream batch;
+		RuleMessageCache messages;
+
+		for (size_t i{ firstRecord }; i < rejectedRecords.size(); i++) {
+			WriteRejectedRecord(batch, rejectedRecords[i], messages);
+			if ((size_t)batch.tellp() >= ERROR_BATCH_BYTES) {
+				file << batch.str();
+				batch.str("");
+			}
+		}
+		file << batch.str();
+		file.close();
+	}, move(Errfile));
+}
+
+// Blocks until a pending asynchronous write of ErrorFile.txt has finished
+void Inventory::WaitForErrorFile() {
+	if (errorFileFlush.valid()) {
+		errorFileFlush.get();
+	}
+}
+
+// Formats one rejected record as an error report line: the fields re-read from the raw line in fixed-width
+// columns, then the messages for the rules it failed
+void Inventory::WriteRejectedRecord(ostream& out, const RejectedRecord& record, RuleMessageCache& messages) {
+	const char* lineBegin = rejectedText.data() + record.textOffset;
+	string_view carID, model;
+	int quantity{ 0 };
+	double price{ 0 };
+
+	LineScanner scanner(lineBegin, lineBegin + record.textLength);
+	scanner >> carID >> model >> quantity >> price;
+
+	out << left << setw(TEXT_WIDTH) << carID << setw(TEXT_WIDTH) << model << setw(NUM_WIDTH) << right << quantity
+		<< setw(NUM_WIDTH) << right << price << left << " " << messages.Get(record.failedRules) << "\n";
+}
+
+// Returns true if the record passes every rule of the active rule set
+bool Inventory::IsValidRecord(string_view carID, string_view model, int quantity, double price) const {
+	return ValidateRecord(carID, model, quantity, price) == 0;
+}
+
+// Runs every validator and returns the RULE_* bits of all rules the record fails, or 0 for a valid record.
+// No message text is built here; DescribeFailedRules produces it from the bits when a report is written.
+unsigned Inventory::ValidateRecord(const string_view carID, const string_view model, const int quantity, const double price) const {
+	return ValidateCarID(carID) | ValidateModel(model) | ValidateQuantity(quantity) | ValidatePrice(price);
+}
+
+// Validate the car ID against the active rule set: the length must be REQ_ID_LEN, and every segment of positions
+// must hold characters of its class (by default 2 letters, then 6 alphanumerics, then 1 digit)
+unsigned Inventory::ValidateCarID(string_view carID) const {
+	return ActiveValidator::IdFailures(carID);
+}
+
+// Check if the model is at least MIN_MODEL_LEN characters long, starts with a capital letter, and is alphanumeric
+unsigned Inventory::ValidateModel(string_view model) const {
+	return ActiveValidator::ModelFailures(model);
+}
+
+// Check if the quantity is greater than or equal to MIN_QUANTITY
+unsigned Inventory::ValidateQuantity(int quantity) const {
+	return (quantity >= MIN_QUANTITY) ? 0 : RULE_QUANTITY;
+}
+
+// Check if the price is greater than MIN_PRICE; an infinite price (e.g. one that overflowed) is rejected
+unsigned Inventory::ValidatePrice(double price) const {
+	return (price > MIN_PRICE && isfinite(price)) ? 0 : RULE_PRICE;
+}
+
+// Sorts the inventory by user-specified field in descending order. Records with equal keys keep their
+// store (file) order, so the result depends only on the data and not on the previous display order.
+// Each field's permutation is cached, so switching back to a field that was sorted before costs nothing.
+void Inventory::SortBy(int field) {
+	GetSortedOrder(field);
+	displayField = field;
+}
+
+// Returns the cached permutation for a field, sorting only what the cache does not cover yet: nothing if it is
+// current, the appended records if records were added since, or everything if it was invalidated
+const vector<int>& Inventory::GetSortedOrder(int field) {
+	if (field < ID || field > PRICE) {
+		cerr << "ERROR: Invalid field. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+
+	vector<int>& order = fieldOrders[field];
+	if ((int)order.size() == GetNumCars()) {
+		return order;
+	}
+
+	switch (field) {
+	case ID: // Sort by ID
+		SortByID(order);
+		break;
+	case MODEL: // Sort by Model
+		SortByModel(order);
+		break;
+	case QUANTITY: // Sort by Quantity
+		SortByQuantity(order);
+		break;
+	case PRICE: // Sort by Price
+		SortByPrice(order);
+		break;
+	}
+	return order;
+}
+
+// Changing a key moves the record within that field's order, so only that cached permutation is dropped
+void Inventory::SetQuantity(int index, int quantity) {
+	quantities[index] = quantity;
+	InvalidateOrder(QUANTITY);
+	MarkDirty(index);
+	LogChange(index, QUANTITY_SET, quantity, 0);
+}
+
+// Applies a sale (negative delta) or a delivery (positive delta) to a record's quantity. Returns false, changing and
+// logging nothing, if the result would overflow or fail ValidateQuantity, e.g. a sale of more cars than are in stock.
+bool Inventory::AdjustQuantity(int index, int delta) {
+	long long quantity = (long long)quantities[index] + delta;
+	if (quantity < numeric_limits<int>::min() || quantity > numeric_limits<int>::max() || ValidateQuantity((int)quantity) != 0) {
+		return false;
+	}
+
+	quantities[index] = (int)quantity;
+	InvalidateOrder(QUANTITY);
+	MarkDirty(index);
+	LogChange(index, QUANTITY_DELTA, delta, 0);
+	return true;
+}
+
+void Inventory::SetPrice(int index, double price) {
+	prices[index] = price;
+	InvalidateOrder(PRICE);
+	MarkDirty(index);
+	LogChange(index, PRICE_SET, 0, price);
+}
+
+// Queues a change to the record at index for the journal, if there is one. It reaches the disk with the next group
+// commit; WaitForJournal waits for that.
+void Inventory::LogChange(int index, JournalChange kind, int quantity, double price) {
+	if (journal == nullptr) {
+		return;
+	}
+
+	JournalEntry entry{};
+	entry.carID = carIDs[index];
+	entry.kind = (uint8_t)kind;
+	entry.quantity = quantity;
+	entry.price = price;
+	journal->Append(entry);
+}
+
+// IDs are radix sorted on their complemented packed keys, so no ID characters are compared at all
+void Inventory::SortByID(vector<int>& order) {
+	SortByKey<uint64_t>([this](int i) { return IdSortKey(i); }, order);
+}
+
+// Models are radix sorted on the complemented name rank of their handle, so no model names are compared per record
+void Inventory::SortByModel(vector<int>& order) {
+	const vector<uint32_t>& ranks = modelPool.GetRanks();
+	SortByKey<uint32_t>([this, &ranks](int i) { return ModelSortKey(i, ranks); }, order);
+}
+
+// Quantities are radix sorted on their complemented, sign-flipped bits, which orders them descending
+void Inventory::SortByQuantity(vector<int>& order) {
+	SortByKey<uint32_t>([this](int i) { return QuantitySortKey(i); }, order);
+}
+
+// Prices are radix sorted on their IEEE-754 bits, mapped to unsigned integers that order the same way and then complemented
+void Inventory::SortByPrice(vector<int>& order) {
+	SortByKey<uint64_t>([this](int i) { return PriceSortKey(i); }, order);
+}
+
+uint64_t Inventory::PriceKey(double price) {
+	uint64_t bits;
+	memcpy(&bits, &price, sizeof(bits));
+	bits = (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+	return ~bits;
+}
+
+// Fills top with the store indices of the first k records of the field's descending order, exactly as SortBy would
+// list them. A current cached order is simply cut short; a large k sorts (and caches) the whole field; otherwise the
+// records are scanned with a bounded heap in O(n log k) without touching the cache.
+void Inventory::TopK(int field, int k, vector<int>& top) {
+	if (field < ID || field > PRICE) {
+		cerr << "ERROR: Invalid field. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+
+	int numCars = GetNumCars();
+	k = max(0, min(k, numCars));
+	if ((int)fieldOrders[field].size() == numCars || (long long)k * TOP_K_SORT_DIVISOR > numCars) {
+		const vector<int>& order = GetSortedOrder(field);
+		top.assign(order.begin(), order.begin() + k);
+		return;
+	}
+
+	switch (field) {
+	case ID:
+		SelectTopByKey<uint64_t>([this](int i) { return IdSortKey(i); }, k, top);
+		break;
+	case MODEL: {
+		const vector<uint32_t>& ranks = modelPool.GetRanks();
+		SelectTopByKey<uint32_t>([this, &ranks](int i) { return ModelSortKey(i, ranks); }, k, top);
+		break;
+	}
+	case QUANTITY:
+		SelectTopByKey<uint32_t>([this](int i) { return QuantitySortKey(i); }, k, top);
+		break;
+	case PRICE:
+		SelectTopByKey<uint64_t>([this](int i) { return PriceSortKey(i); }, k, top);
+		break;
+	}
+}
+
+// Reorders a subset of store indices the way SortBy orders the field and keeps the first limit of them. Unlike
+// GetSortedOrder this costs O(m log m) in the subset size, so small query results are not sorted through the cache.
+void Inventory::OrderBy(int field, vector<int>& indices, size_t limit) {
+	limit = min(limit, indices.size());
+	switch (field) {
+	case ID:
+		OrderByKey<uint64_t>([this](int i) { return IdSortKey(i); }, indices, limit);
+		break;
+	case MODEL: {
+		const vector<uint32_t>& ranks = modelPool.GetRanks();
+		OrderByKey<uint32_t>([this, &ranks](int i) { return ModelSortKey(i, ranks); }, indices, limit);
+		break;
+	}
+	case QUANTITY:
+		OrderByKey<uint32_t>([this](int i) { return QuantitySortKey(i); }, indices, limit);
+		break;
+	case PRICE:
+		OrderByKey<uint64_t>([this](int i) { return PriceSortKey(i); }, indices, limit);
+		break;
+	default:
+		cerr << "ERROR: Invalid field. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+}
+
+template <typename Key, typename KeyFunction>
+void Inventory::OrderByKey(KeyFunction keyOf, vector<int>& indices, size_t limit) {
+	auto less = [](const KeyedIndex<Key>& a, const KeyedIndex<Key>& b) { return a.key < b.key || (a.key == b.key && a.index < b.index); };
+	vector<KeyedIndex<Key>> items(indices.size());
+
+	for (size_t i{ 0 }; i < indices.size(); i++) {
+		items[i] = { keyOf(indices[i]), indices[i] };
+	}
+	partial_sort(items.begin(), items.begin() + limit, items.end(), less);
+	indices.resize(limit);
+	for (size_t i{ 0 }; i < limit; i++) {
+		indices[i] = items[i].index;
+	}
+}
+
+// Selects the k smallest (key, index) pairs, the same order SortByKey produces. Each slice keeps a max-heap of its
+// best k so far; since indices are scanned in increasing order, a record only enters the heap when its key is strictly
+// smaller than the heap's worst, which rejects most records with one comparison. The slice winners are then sorted.
+template <typename Key, typename KeyFunction>
+void Inventory::SelectTopByKey(KeyFunction keyOf, int k, vector<int>& top) {
+	auto less = [](const KeyedIndex<Key>& a, const KeyedIndex<Key>& b) { return a.key < b.key || (a.key == b.key && a.index < b.index); };
+	int numCars = GetNumCars();
+	int numThreads = (numCars >= PARALLEL_SORT_THRESHOLD) ? sortThreads : 1;
+	vector<vector<KeyedIndex<Key>>> heaps(numThreads);
+
+	top.clear();
+	if (k == 0) {
+		return;
+	}
+
+	RunParallel(numThreads, [&](int t) {
+		int first = (int)((long long)numCars * t / numThreads);
+		int last = (int)((long long)numCars * (t + 1) / numThreads);
+		vector<KeyedIndex<Key>>& heap = heaps[t];
+
+		heap.reserve(k);
+		for (int i{ first }; i < last; i++) {
+			Key key = keyOf(i);
+			if ((int)heap.size() < k) {
+				heap.push_back({ key, i });
+				push_heap(heap.begin(), heap.end(), less);
+			}
+			else if (key < heap.front().key) {
+				pop_heap(heap.begin(), heap.end(), less);
+				heap.back() = { key, i };
+				push_heap(heap.begin(), heap.end(), less);
+			}
+		}
+	});
+
+	vector<KeyedIndex<Key>> candidates;
+	for (vector<KeyedIndex<Key>>& heap : heaps) {
+		candidates.insert(candidates.end(), heap.begin(), heap.end());
+	}
+	partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(), less);
+	for (int i{ 0 }; i < k; i++) {
+		top.push_back(candidates[i].index);
+	}
+}
+
+// Shared driver for the field sorts. keyOf maps a store index to a radix key; records are ordered by key, then by
+// store index, which is also the order runs are merged in.
+// On entry order is a sorted permutation of the first order.size() records (empty for a full sort); only the
+// records after those are sorted, then merged into it.
+// When at least PARALLEL_SORT_THRESHOLD records need sorting they are cut into one slice per sort thread; the
+// slices are sorted concurrently and merged pairwise in parallel rounds. Since (key, index) is a total order, the
+// parallel and incremental results are identical to a serial full sort.
+template <typename Key, typename KeyFunction>
+void Inventory::SortByKey(KeyFunction keyOf, vector<int>& order) {
+	auto less = [](const KeyedIndex<Key>& a, const KeyedIndex<Key>& b) { return a.key < b.key || (a.key == b.key && a.index < b.index); };
+	int numCars = GetNumCars();
+	int firstNew = (int)order.size();
+	int numNew = numCars - firstNew;
+	int numThreads = (numNew >= PARALLEL_SORT_THRESHOLD) ? sortThreads : 1;
+	vector<vector<KeyedIndex<Key>>> runs(numThreads);
+
+	RunParallel(numThreads, [&](int t) {
+		int first = firstNew + (int)((long long)numNew * t / numThreads);
+		int last = firstNew + (int)((long long)numNew * (t + 1) / numThreads);
+		vector<KeyedIndex<Key>>& items = runs[t];
+
+		items.resize(last - first);
+		for (int i{ first }; i < last; i++) {
+			items[i - first] = { keyOf(i), i };
+		}
+		RadixSort(items);
+	});
+
+	while (runs.size() > 1) {
+		vector<vector<KeyedIndex<Key>>> merged((runs.size() + 1) / 2);
+
+		RunParallel((int)merged.size(), [&](int m) {
+			if (2 * m + 1 == (int)runs.size()) {
+				merged[m] = move(runs[2 * m]);
+			}
+			else {
+				merged[m].resize(runs[2 * m].size() + runs[2 * m + 1].size());
+				merge(runs[2 * m].begin(), runs[2 * m].end(), runs[2 * m + 1].begin(), runs[2 * m + 1].end(), merged[m].begin(), less);
+				vector<KeyedIndex<Key>>().swap(runs[2 * m]);
+				vector<KeyedIndex<Key>>().swap(runs[2 * m + 1]);
+			}
+		});
+		runs.swap(merged);
+	}
+
+	if (firstNew > 0) {
+		vector<KeyedIndex<Key>> cached(firstNew);
+		vector<KeyedIndex<Key>> merged(numCars);
+
+		for (int i{ 0 }; i < firstNew; i++) {
+			cached[i] = { keyOf(order[i]), order[i] };
+		}
+		merge(cached.begin(), cached.end(), runs[0].begin(), runs[0].end(), merged.begin(), less);
+		runs[0].swap(merged);
+	}
+
+	order.resize(numCars);
+	for (int i{ 0 }; i < numCars; i++) {
+		order[i] = runs[0][i].index;
+	}
+}
+
+// Takes in a string and converts all alphabetical characters to uppercase
+void Inventory::MakeStringUppercase(string& str) {
+	for (int i{ 0 }; i < str.length(); i++) {
+		str[i] = toupper(str[i]);
+	}
+}
+
+void Inventory::PrintInventory() {
+	int numCars = GetNumCars();
+
+	PrintTableHeader("VALID ITEMS IN THE INVENTORY");
+	WriteRows(0, numCars);
+
+	cout << "\nTotal Records: " << numCars << "\n";
+	if (numDuplicates > 0 && duplicatePolicy != KEEP_ALL) {
+		cout << "Duplicate IDs: " << numDuplicates << ((duplicatePolicy == KEEP_FIRST) ? " (first record kept)\n"
+			: (duplicatePolicy == KEEP_LAST) ? " (last record kept)\n" : " (quantities summed)\n");
+	}
+	cout << setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ') << "\n\n";
+}
+
+// Prints the records at the given store indices, in that order, with a record count
+void Inventory::PrintRecords(const string& title, const vector<int>& indices) {
+	PrintTableHeader(title);
+	{
+		RowWriter writer(cout);
+		for (int index : indices) {
+			writer.AppendRecord(carIDs[index], modelPool.GetName(modelHandles[index]), quantities[index], prices[index]);
+		}
+	}
+	cout << "\nTotal Records: " << indices.size() << "\n"
+		<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ') << "\n\n";
+}
+
+// Writes the records at the given store indices, in that order, for other programs: CSV with a header row, or one
+// JSON object per line. Valid IDs and models are alphanumeric, so neither format needs quoting or escaping.
+void Inventory::WriteRecords(ostream& out, const vector<int>& indices, OutputFormat format) {
+	RowWriter writer(out);
+
+	if (format == CSV_FORMAT) {
+		writer.AppendText("id,model,quantity,price\n", 0);
+	}
+	for (int index : indices) {
+		string_view carID(carIDs[index].chars, REQ_ID_LEN);
+		string_view model = modelPool.GetName(modelHandles[index]);
+
+		if (format == CSV_FORMAT) {
+			writer.AppendText(carID, 0);
+			writer.AppendChar(',');
+			writer.AppendText(model, 0);
+			writer.AppendChar(',');
+			writer.AppendInt(quantities[index], 0);
+			writer.AppendChar(',');
+			writer.AppendFixed(prices[index], 0);
+		}
+		else {
+			writer.AppendText("{\"id\":\"", 0);
+			writer.AppendText(carID, 0);
+			writer.AppendText("\",\"model\":\"", 0);
+			writer.AppendText(model, 0);
+			writer.AppendText("\",\"quantity\":", 0);
+			writer.AppendInt(quantities[index], 0);
+			writer.AppendText(",\"price\":", 0);
+			writer.AppendFixed(prices[index], 0);
+			writer.AppendChar('}');
+		}
+		writer.AppendChar('\n');
+	}
+}
+
+// Prints the aggregate report: stock totals, quantity and price statistics, the price histogram, and per-model
+// totals in model name order
+void Inventory::PrintReport() {
+	InventoryAggregate report = Aggregate();
+	ios::fmtflags flags = cout.flags(); // The table switches to left alignment; later output expects the old flags
+
+	cout << "INVENTORY REPORT\n"
+		<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ');
+	if (report.numCars == 0) {
+		cout << "No Valid Records Found.\n\n";
+		return;
+	}
+
+	cout << left << setw(2 * TEXT_WIDTH) << "Total Records:" << report.numCars << "\n"
+		<< setw(2 * TEXT_WIDTH) << "Total Units:" << report.totalQuantity << "\n"
+		<< setw(2 * TEXT_WIDTH) << "Out of Stock Records:" << report.numOutOfStock << "\n"
+		<< setw(2 * TEXT_WIDTH) << "Total Stock Value:" << report.totalValue << "\n\n"
+		<< setw(2 * TEXT_WIDTH) << "Quantity (min/max/mean):" << report.minQuantity << " / " << report.maxQuantity << " / "
+		<< (double)report.totalQuantity / report.numCars << "\n"
+		<< setw(2 * TEXT_WIDTH) << "Price (min/max/mean):" << report.minPrice << " / " << report.maxPrice << " / "
+		<< report.priceSum / report.numCars << "\n\n";
+
+	cout << "Price Distribution\n";
+	long long largestBucket = *max_element(report.priceHistogram.begin(), report.priceHistogram.end());
+	double bucketWidth = (report.maxPrice - report.minPrice) / PRICE_HISTOGRAM_BUCKETS;
+	for (int b{ 0 }; b < PRICE_HISTOGRAM_BUCKETS; b++) {
+		cout << right << setw(NUM_WIDTH) << report.minPrice + b * bucketWidth << " - " << setw(NUM_WIDTH) << report.minPrice + (b + 1) * bucketWidth
+			<< setw(NUM_WIDTH) << report.priceHistogram[b] << " " << left
+			<< string((size_t)(largestBucket > 0 ? report.priceHistogram[b] * HISTOGRAM_BAR_WIDTH / largestBucket : 0), '#') << "\n";
+	}
+
+	// Handles ordered by rank list the models alphabetically
+	const vector<uint32_t>& ranks = modelPool.GetRanks();
+	vector<uint32_t> byName(ranks.size());
+	for (uint32_t h{ 0 }; h < ranks.size(); h++) {
+		byName[ranks[h]] = h;
+	}
+
+	cout << "\n" << left << setw(TEXT_WIDTH) << "Model" << right << setw(NUM_WIDTH) << "Records" << setw(NUM_WIDTH) << "Units"
+		<< setw(NUM_WIDTH + 6) << "Stock Value" << "\n";
+	{
+		RowWriter writer(cout);
+		for (uint32_t handle : byName) {
+			const ModelTotals& totals = report.modelTotals[handle];
+			if (totals.numCars > 0) {
+				writer.AppendText(modelPool.GetName(handle), TEXT_WIDTH);
+				writer.AppendInt(totals.numCars, NUM_WIDTH);
+				writer.AppendInt(totals.quantity, NUM_WIDTH);
+				writer.AppendFixed(totals.value, NUM_WIDTH + 6);
+				writer.AppendChar('\n');
+			}
+		}
+	}
+
+	cout << setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ') << "\n";
+	cout.flags(flags);
+}
+
+// Prints the record at the given store index as a one-row table
+void Inventory::PrintCar(int index) {
+	PrintTableHeader("VEHICLE " + carIDs[index].toString());
+	{
+		RowWriter writer(cout);
+		writer.AppendRecord(carIDs[index], modelPool.GetName(modelHandles[index]), quantities[index], prices[index]);
+	}
+	cout << setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ') << "\n\n";
+}
+
+// Prints the window of pageSize records starting at offset in the current display order.
+// Only the rows in the window are formatted, so a page costs the same however large the inventory is.
+void Inventory::PrintPage(int offset, int pageSize) {
+	int numCars = GetNumCars();
+	int first = max(0, min(offset, numCars));
+	int last = (int)min<long long>((long long)first + pageSize, numCars);
+
+	PrintTableHeader("VALID ITEMS IN THE INVENTORY");
+	WriteRows(first, last);
+
+	cout << "\nShowing Records: ";
+	if (first < last) {
+		cout << first + 1 << "-" << last << " of " << numCars << "\n";
+	}
+	else {
+		cout << "0 of " << numCars << "\n";
+	}
+	cout << setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ') << "\n\n";
+}
+
+// Writes the records at display positions [first, last) of the current display order
+void Inventory::WriteRows(int first, int last) {
+	const vector<int>* order = (displayField == 0) ? nullptr : &GetSortedOrder(displayField);
+	RowWriter writer(cout);
+
+	for (int i{ first }; i < last; i++) {
+		int index = order ? (*order)[i] : i;
+		writer.AppendRecord(carIDs[index], modelPool.GetName(modelHandles[index]), quantities[index], prices[index]);
+	}
+	writer.Flush();
+}
+
+// Prints a report title, a divider and the column headings
+void PrintTableHeader(const string& title) {
+	stringstream ssHeader;
+
+	ssHeader << fixed << showpoint << setprecision(2) << left
+		<< setw(TEXT_WIDTH) << "Vehicle ID"
+		<< setw(TEXT_WIDTH) << "Model"
+		<< setw(NUM_WIDTH) << right << "Quantity"
+		<< setw(NUM_WIDTH) << "Price" << left << "\n\n";
+
+	cout << title << "\n"
+		<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n" //use setfill print -
+		<< setfill(' ') // Reset setfill to default space character
+		<< ssHeader.str();
+}
+
+int GetMenuSelection() {
+	int selection;
+
+	cout << "Main Menu:\n"
+		"Please select one of the following options:\n"
+		"1. Valid Records\n"
+		"2. Invalid Records\n"
+		"3. Sort Inventory\n"
+		"4. Browse Inventory (paged)\n"
+		"5. Find Car by ID\n"
+		"6. Query Inventory\n"
+		"7. Inventory Report\n"
+		"8. Top Records\n"
+		"9. Follow Data File\n"
+		"10. Quit program\n"
+		"Selection: ";
+	cin >> selection;
+	cout << endl;
+
+	return selection;
+}
+
+void SortMenu(Inventory& inventory) {
+	int field = GetSortKey();
+
+	if (field != RETURN_TO_MAIN) {
+		switch (field) {
+		case ID:
+			cout << "Sorting by ID\n\n";
+			break;
+		case MODEL:
+			cout << "Sorting by Model\n\n";
+			break;
+		case QUANTITY:
+			cout << "Sorting by Quantity\n\n";
+			break;
+		case PRICE:
+			cout << "Sorting by Price\n\n";
+			break;
+		default:
+			PurgeInputErrors("ERROR: Invalid case in SortMenu. Terminating Program.\n");
+			exit(EXIT_FAILURE);
+		}
+		inventory.SortBy(field);
+		inventory.PrintInventory();
+	}
+	else {
+		cout << "Returning to Main Menu\n\n";
+	}
+}
+
+int GetSortKey() {
+	int key;
+
+	do {
+		cout << "Sort Menu:\n"
+			"Please select one of the following sorting options:\n"
+			"1. ID\n"
+			"2. Model\n"
+			"3. Quantity\n"
+			"4. Price\n"
+			"5. Return to Main Menu\n"
+			"Selection: ";
+
+		cin >> key;
+		cout << "\n";
+
+		if (key < ID || key > RETURN_TO_MAIN) {
+			PurgeInputErrors("Error: Invalid menu selection\n\n");
+		}
+	} while (key < ID || key > RETURN_TO_MAIN);
+
+	return key;
+}
+
+// Pages through the inventory in its current display order
+void BrowseMenu(Inventory& inventory) {
+	int offset = 0;
+	int pageSize = DEFAULT_PAGE_SIZE;
+	int option;
+
+	do {
+		inventory.PrintPage(offset, pageSize);
+		option = GetBrowseOption();
+
+		switch (option) {
+		case NEXT_PAGE:
+			// In long long, as a page size near INT_MAX would overflow the sum
+			if ((long long)offset + pageSize < inventory.GetNumCars()) {
+				offset += pageSize;
+			}
+			break;
+		case PREVIOUS_PAGE:
+			offset = max(0, offset - pageSize);
+			break;
+		case JUMP_TO_RECORD:
+			cout << "Record number (1-" << inventory.GetNumCars() << "): ";
+			if (cin >> offset && offset >= 1 && offset <= inventory.GetNumCars()) {
+				offset--;
+				cout << "\n";
+			}
+			else {
+				offset = 0;
+				PurgeInputErrors("\nError: Invalid record number. Returning to the first page\n\n");
+			}
+			break;
+		case SET_PAGE_SIZE:
+			cout << "Records per page: ";
+			if (!(cin >> pageSize) || pageSize < 1) {
+				pageSize = DEFAULT_PAGE_SIZE;
+				PurgeInputErrors("\nError: Invalid page size. Using the default page size\n\n");
+			}
+			else {
+				cout << "\n";
+			}
+			break;
+		case RETURN_FROM_BROWSE:
+			cout << "Returning to Main Menu\n\n";
+			break;
+		}
+	} while (option != RETURN_FROM_BROWSE);
+}
+
+int GetBrowseOption() {
+	int option;
+
+	do {
+		cout << "Browse Menu:\n"
+			"Please select one of the following options:\n"
+			"1. Next Page\n"
+			"2. Previous Page\n"
+			"3. Jump to Record\n"
+			"4. Set Page Size\n"
+			"5. Return to Main Menu\n"
+			"Selection: ";
+
+		cin >> option;
+		cout << "\n";
+
+		if (option < NEXT_PAGE || option > RETURN_FROM_BROWSE) {
+			PurgeInputErrors("Error: Invalid menu selection\n\n");
+		}
+	} while (option < NEXT_PAGE || option > RETURN_FROM_BROWSE);
+
+	return option;
+}
+
+// Looks up one car by ID through the ID index
+void FindMenu(Inventory& inventory) {
+	string carID;
+
+	cout << "Car ID: ";
+	if (!(cin >> carID)) {
+		PurgeInputErrors("\nError: Invalid car ID\n\n");
+		return;
+	}
+	cout << "\n";
+
+	inventory.MakeStringUppercase(carID);
+	int index = inventory.FindCar(carID);
+	if (index < 0) {
+		cout << "No car with ID '" << carID << "' in the inventory\n\n";
+	}
+	else {
+		inventory.PrintCar(index);
+	}
+}
+
+// Builds a query one criterion at a time and runs it against the secondary indexes
+void QueryMenu(Inventory& inventory) {
+	InventoryQuery query;
+	vector<int> matches;
+	int option;
+
+	do {
+		option = GetQueryOption(query);
+
+		switch (option) {
+		case SET_QUANTITY_RANGE:
+			cout << "Minimum and maximum quantity: ";
+			if (!(cin >> query.minQuantity >> query.maxQuantity) || query.minQuantity > query.maxQuantity) {
+				query.minQuantity = numeric_limits<int>::min();
+				query.maxQuantity = numeric_limits<int>::max();
+				PurgeInputErrors("\nError: Invalid quantity range. The quantity range was cleared\n\n");
+			}
+			else {
+				cout << "\n";
+			}
+			break;
+		case SET_PRICE_RANGE:
+			cout << "Minimum and maximum price: ";
+			if (!(cin >> query.minPrice >> query.maxPrice) || !(query.minPrice <= query.maxPrice)) {
+				query.minPrice = -numeric_limits<double>::infinity();
+				query.maxPrice = numeric_limits<double>::infinity();
+				PurgeInputErrors("\nError: Invalid price range. The price range was cleared\n\n");
+			}
+			else {
+				cout << "\n";
+			}
+			break;
+		case SET_ID_PREFIX:
+			cout << "ID prefix: ";
+			cin >> query.idPrefix;
+			inventory.MakeStringUppercase(query.idPrefix);
+			cout << "\n";
+			break;
+		case RUN_QUERY: {
+			int field = inventory.Query(query, matches);
+			const char* fieldNames[] = { "file order", "ID index", "model index", "quantity index", "price index" };
+
+			inventory.PrintRecords("QUERY RESULTS: " + query.toString(), matches);
+			cout << "Answered through the " << fieldNames[field] << "\n\n";
+			break;
+		}
+		case CLEAR_QUERY:
+			query = InventoryQuery();
+			cout << "Query cleared\n\n";
+			break;
+		case RETURN_FROM_QUERY:
+			cout << "Returning to Main Menu\n\n";
+			break;
+		}
+	} while (option != RETURN_FROM_QUERY);
+}
+
+int GetQueryOption(const InventoryQuery& query) {
+	int option;
+
+	do {
+		cout << "Query Menu (current query: " << query.toString() << "):\n"
+			"Please select one of the following options:\n"
+			"1. Set Quantity Range\n"
+			"2. Set Price Range\n"
+			"3. Set ID Prefix\n"
+			"4. Run Query\n"
+			"5. Clear Query\n"
+			"6. Return to Main Menu\n"
+			"Selection: ";
+
+		cin >> option;
+		cout << "\n";
+
+		if (option < SET_QUANTITY_RANGE || option > RETURN_FROM_QUERY) {
+			PurgeInputErrors("Error: Invalid menu selection\n\n");
+		}
+	} while (option < SET_QUANTITY_RANGE || option > RETURN_FROM_QUERY);
+
+	return option;
+}
+
+// Lists the k highest records of one field, in the same order and layout as sorting the inventory by it
+void TopKMenu(Inventory& inventory) {
+	const char* fieldNames[] = { "", "ID", "MODEL", "QUANTITY", "PRICE" };
+	int field = GetSortKey();
+	int k;
+	vector<int> top;
+
+	if (field == RETURN_TO_MAIN) {
+		cout << "Returning to Main Menu\n\n";
+		return;
+	}
+
+	cout << "Number of records: ";
+	if (!(cin >> k) || k < 1) {
+		k = DEFAULT_TOP_K;
+		PurgeInputErrors("\nError: Invalid record count. Showing the top " + to_string(DEFAULT_TOP_K) + "\n\n");
+	}
+	else {
+		cout << "\n";
+	}
+
+	inventory.TopK(field, k, top);
+	inventory.PrintRecords("TOP " + to_string(top.size()) + " BY " + fieldNames[field], top);
+}
+
+// Watches the data file and merges appended lines into the inventory as they arrive, until Enter is pressed
+void FollowMenu(Inventory& inventory) {
+	atomic<bool> stopRequested{ false };
+
+	// Drop the rest of the menu selection line so only a fresh Enter stops following
+	cin.ignore(numeric_limits<streamsize>::max(), '\n');
+	cout << "Following 'Data.txt'. Press Enter to stop.\n\n";
+
+	thread inputWaiter([&stopRequested]() {
+		string line;
+		getline(cin, line);
+		stopRequested = true;
+	});
+
+	while (!stopRequested) {
+		long long linesBefore = inventory.GetNumLines();
+		int numCars = inventory.GetNumCars();
+		int numInvalid = inventory.GetNumInvalidRecords();
+		long long numLines = inventory.IngestAppended();
+
+		// After a reload every record in the store is new
+		if (inventory.GetNumLines() != linesBefore + numLines) {
+			numCars = 0;
+			numInvalid = 0;
+		}
+		if (numLines > 0) {
+			cout << "Read " << numLines << " new line(s): " << inventory.GetNumCars() - numCars << " valid, "
+				<< inventory.GetNumInvalidRecords() - numInvalid << " invalid. Inventory now holds "
+				<< inventory.GetNumCars() << " cars\n";
+		}
+		this_thread::sleep_for(chrono::milliseconds(FOLLOW_POLL_MS));
+	}
+	inputWaiter.join();
+
+	cout << "Returning to Main Menu\n\n";
+}
+
+// Prints every rejected record from the error store
+void Inventory::PrintInvalidRecords() {
+	if (rejectedRecords.empty()) {
+		cout << "No Invalid Records Found.\n\n";
+		return;
+	}
+
+	PrintTableHeader("INVALID RECORDS");
+
+	// Rows use the default float format, so they are formatted into their own stream rather than cout
+	ostringstream batch;
+	RuleMessageCache messages;
+	for (const RejectedRecord& record : rejectedRecords) {
+		WriteRejectedRecord(batch, record, messages);
+		if ((size_t)batch.tellp() >= ERROR_BATCH_BYTES) {
+			cout << batch.str();
+			batch.str("");
+		}
+	}
+	cout << batch.str();
+
+	cout << "\nTotal Records: " << rejectedRecords.size() << "\n"
+		<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
+		<< setfill(' ') << "\n\n";
+}
+
+// Batch mode: loads one data file, selects, orders and limits its records as the options say, streams them to stdout
+// and exits with EXIT_SUCCESS; unreadable files exit with EXIT_FAILURE and bad options with EXIT_USAGE. Nothing is
+// read from stdin and diagnostics go to stderr, so any number of feeds can run side by side.
+// --input may be repeated or name a directory; the feeds are then loaded as shards and merged in the order given.
+// With --journal the changes --movements makes are logged to PATH and replayed on the next run; --compact then
+// folds the journal into its base file, PATH.base.
+// Usage: --batch [--input PATH]... [--errors PATH] [--snapshot] [--duplicates all|first|last|sum]
+//        [--journal PATH] [--movements PATH] [--compact]
+//        [--min-quantity N] [--max-quantity N] [--min-price X] [--max-price X] [--id-prefix P]
+//        [--sort id|model|quantity|price] [--limit N] [--format table|csv|json]
+int RunBatch(int argc, char* argv[]) {
+	BatchConfig config;
+	vector<int> records;
+
+	ParseBatchArgs(argc, argv, config);
+	Inventory inventory(PARALLEL_PARSE, config.writeErrorFile, config.useSnapshot, config.duplicatePolicy, config.files);
+	if (!config.movementsFileName.empty() && !ApplyMovements(inventory, config.movementsFileName)) {
+		return EXIT_FAILURE;
+	}
+	if (config.compactJournal) {
+		inventory.CompactJournal();
+	}
+	int numCars = inventory.GetNumCars();
+	size_t limit = (config.limit < 0) ? (size_t)numCars : (size_t)min<long long>(config.limit, numCars);
+
+	if (config.query.HasCriteria()) {
+		inventory.Query(config.query, records);
+		if (config.sortField != 0) {
+			inventory.OrderBy(config.sortField, records, limit);
+		}
+		else {
+			sort(records.begin(), records.end());
+			records.resize(min(limit, records.size()));
+		}
+	}
+	else if (config.sortField != 0) {
+		inventory.TopK(config.sortField, (int)limit, records);
+	}
+	else {
+		records.resize(limit);
+		for (size_t i{ 0 }; i < limit; i++) {
+			records[i] = (int)i;
+		}
+	}
+
+	if (config.format == TABLE_FORMAT) {
+		const char* fieldNames[] = { "", " BY ID", " BY MODEL", " BY QUANTITY", " BY PRICE" };
+		inventory.PrintRecords("RECORDS: " + config.query.toString() + fieldNames[config.sortField], records);
+	}
+	else {
+		inventory.WriteRecords(cout, records, config.format);
+	}
+
+	inventory.WaitForErrorFile();
+	inventory.WaitForCompaction();
+	if (!cout) {
+		cerr << "ERROR: Unable to write the results\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Applies a file of stock movements, one "ID DELTA [PRICE]" line each: DELTA is added to the car's quantity (negative
+// for a sale) and PRICE, if given, becomes its price. Lines that do not parse, name an unknown car or would leave an
+// invalid quantity or price are rejected whole and counted in a note on stderr. Returns once every change is in the
+// journal on disk; false if the file cannot be read.
+bool ApplyMovements(Inventory& inventory, const string& fileName) {
+	ifstream movementsFile(fileName);
+	string line;
+	long long numRejected = 0;
+
+	if (!movementsFile) {
+		cerr << "ERROR: Unable to open '" << fileName << "'\n";
+		return false;
+	}
+
+	while (getline(movementsFile, line)) {
+		istringstream fields(line);
+		string carID, priceField, extraField;
+		int delta;
+
+		if (!(fields >> carID >> delta)) {
+			numRejected += line.find_first_not_of(" \t\r") != string::npos;
+			continue;
+		}
+		fields >> priceField >> extraField;
+		bool hasPrice = !priceField.empty();
+		char* priceEnd = nullptr;
+		double price = hasPrice ? strtod(priceField.c_str(), &priceEnd) : 0;
+		if ((hasPrice && *priceEnd != '\0') || !extraField.empty()) {
+			numRejected++;
+			continue;
+		}
+		transform(carID.begin(), carID.end(), carID.begin(), [](unsigned char c) { return (char)toupper(c); });
+		int index = inventory.FindCar(carID);
+
+		// The price is checked first, so a rejected movement changes nothing
+		if (index < 0 || (hasPrice && inventory.ValidatePrice(price) != 0) || !inventory.AdjustQuantity(index, delta)) {
+			numRejected++;
+			continue;
+		}
+		if (hasPrice) {
+			inventory.SetPrice(index, price);
+		}
+	}
+
+	if (numRejected > 0) {
+		cerr << "NOTE: Rejected " << numRejected << " stock movements that are malformed, name unknown cars or give an invalid quantity or price\n";
+	}
+	inventory.WaitForJournal();
+	return true;
+}
+
+// Reads the batch options; an unknown option or a missing or out-of-range value ends the program with EXIT_USAGE
+void ParseBatchArgs(int argc, char* argv[], BatchConfig& config) {
+	const char* fieldNames[] = { "", "id", "model", "quantity", "price" };
+	const char* formatNames[] = { "", "table", "csv", "json" };
+	const char* policyNames[] = { "", "first", "last", "sum", "all" };
+	vector<string> inputs;
+
+	auto findName = [](const char* const* names, int count, const string& value) {
+		for (int n{ 1 }; n < count; n++) {
+			if (value == names[n]) {
+				return n;
+			}
+		}
+		return 0;
+	};
+
+	for (int i{ 0 }; i < argc; i++) {
+		string option = argv[i];
+		if (option == "--snapshot" || option == "--compact") {
+			(option == "--snapshot" ? config.useSnapshot : config.compactJournal) = true;
+			continue;
+		}
+		if (i + 1 == argc) {
+			cerr << "ERROR: Missing value for batch option '" << option << "'\n";
+			exit(EXIT_USAGE);
+		}
+
+		string value = argv[++i];
+		bool valid = true;
+		try {
+			if (option == "--input") {
+				inputs.push_back(value);
+				valid = !value.empty();
+			}
+			else if (option == "--errors") {
+				config.files.errorFileName = value;
+				config.writeErrorFile = valid = !value.empty();
+			}
+			else if (option == "--journal") {
+				config.files.journalFileName = value;
+				valid = !value.empty();
+			}
+			else if (option == "--movements") {
+				config.movementsFileName = value;
+				valid = !value.empty();
+			}
+			else if (option == "--duplicates") {
+				config.duplicatePolicy = (DuplicatePolicy)findName(policyNames, 5, value);
+				valid = config.duplicatePolicy != 0;
+			}
+			else if (option == "--min-quantity") {
+				config.query.minQuantity = stoi(value);
+			}
+			else if (option == "--max-quantity") {
+				config.query.maxQuantity = stoi(value);
+			}
+			else if (option == "--min-price") {
+				config.query.minPrice = stod(value);
+			}
+			else if (option == "--max-price") {
+				config.query.maxPrice = stod(value);
+			}
+			else if (option == "--id-prefix") {
+				config.query.idPrefix = value;
+				transform(value.begin(), value.end(), config.query.idPrefix.begin(), [](unsigned char c) { return (char)toupper(c); });
+			}
+			else if (option == "--sort") {
+				config.sortField = findName(fieldNames, 5, value);
+				valid = config.sortField != 0;
+			}
+			else if (option == "--limit") {
+				config.limit = stoll(value);
+				valid = config.limit >= 0;
+			}
+			else if (option == "--format") {
+				config.format = (OutputFormat)findName(formatNames, 4, value);
+				valid = config.format != 0;
+			}
+			else {
+				cerr << "ERROR: Unknown batch option '" << option << "'\n";
+				exit(EXIT_USAGE);
+			}
+		}
+		catch (const exception&) {
+			valid = false;
+		}
+
+		if (!valid) {
+			cerr << "ERROR: Invalid value '" << value << "' for batch option '" << option << "'\n";
+			exit(EXIT_USAGE);
+		}
+	}
+
+	if (config.query.minQuantity > config.query.maxQuantity || !(config.query.minPrice <= config.query.maxPrice)) {
+		cerr << "ERROR: The minimum of a range exceeds its maximum\n";
+		exit(EXIT_USAGE);
+	}
 
-	for (int i{ 0 }; i < numCars; i++) {
-		int minIndex = i;
+	// A single file loads as before; several inputs, or a directory of feeds (in name order), load as shards
+	vector<string> feeds;
+	bool sharded = inputs.size() > 1;
+	for (const string& input : inputs) {
+		error_code error;
+		if (filesystem::is_directory(input, error)) {
+			vector<string> directoryFeeds;
+			for (const filesystem::directory_entry& entry : filesystem::directory_iterator(input, error)) {
+				if (entry.is_regular_file(error)) {
+					directoryFeeds.push_back(entry.path().string());
+				}
+			}
+			sort(directoryFeeds.begin(), directoryFeeds.end());
+			feeds.insert(feeds.end(), directoryFeeds.begin(), directoryFeeds.end());
+			sharded = true;
+		}
+		else {
+			feeds.push_back(input);
+		}
+	}
 
-		for (int j = i + 1; j < numCars; j++) {
-			bool isMinVal = false;
+	if (sharded && feeds.empty()) {
+		cerr << "ERROR: No feed files found in the --input directories\n";
+		exit(EXIT_USAGE);
+	}
+	else if (sharded) {
+		config.files.feedFileNames = feeds;
+		config.files.feedSortField = config.sortField;
+	}
+	else if (!feeds.empty()) {
+		config.files.dataFileName = feeds[0];
+	}
+	if (config.useSnapshot) {
+		config.files.snapshotFileName = config.files.dataFileName + ".snapshot";
+	}
 
-			switch (field) {
-			case ID: // Sort by ID
-				isMinVal = carPtrs[j]->getCarID() > carPtrs[minIndex]->getCarID();
-				break;
-			case MODEL: // Sort by Model
-				isMinVal = carPtrs[j]->getModel() > carPtrs[minIndex]->getModel();
-				break;
-			case QUANTITY: // Sort by Quantity
-				isMinVal = carPtrs[j]->getQuantity() > carPtrs[minIndex]->getQuantity();
-				break;
-			case PRICE: // Sort by Price
-				isMinVal = carPtrs[j]->getPrice() > carPtrs[minIndex]->getPrice();
-				break;
-			default:
-				cout << "ERROR: Invalid field. Terminating Program\n";
-				exit(EXIT_FAILURE);
+	if (config.compactJournal && config.files.journalFileName.empty()) {
+		cerr << "ERROR: --compact needs --journal\n";
+		exit(EXIT_USAGE);
+	}
+}
+
+// Benchmark mode: generates a synthetic Data.txt in a scratch directory and times parsing, each validator, the
+// field sorts and printing separately. Every stage is run config.repeat times and reported as one JSON object per
+// line on stdout, with the fastest run's throughput and the process's peak RSS so far.
+// Usage: --benchmark [--records N] [--invalid-ratio R] [--duplicate-ratio R] [--ids random|sequential]
+//        [--models N] [--model-skew S] [--seed N] [--repeat N]
+int RunBenchmark(int argc, char* argv[]) {
+	BenchmarkConfig config;
+	BenchmarkFeed feed;
+	error_code error;
+
+	ParseBenchmarkArgs(argc, argv, config);
+
+	filesystem::path startDirectory = filesystem::current_path();
+	filesystem::path scratchDirectory = EnterScratchDirectory("inventory-benchmark-");
+
+	cout << "{\"stage\":\"config\",\"records\":" << config.numRecords << ",\"invalid_ratio\":" << config.invalidRatio
+		<< ",\"duplicate_ratio\":" << config.duplicateRatio << ",\"ids\":\"" << (config.sequentialIds ? "sequential" : "random")
+		<< "\",\"models\":" << config.numModels << ",\"model_skew\":" << config.modelSkew << ",\"seed\":" << config.seed
+		<< ",\"repeat\":" << config.repeat << ",\"threads\":" << max(1, (int)thread::hardware_concurrency()) << "}" << endl;
+
+	ReportBenchmark("generate", config.numRecords, TimeBest(1, [&]() {
+		GenerateBenchmarkFeed(config, feed);
+	}));
+
+	// Parsing, once per parse mode and once from the snapshot the last parse wrote
+	unique_ptr<Inventory> inventory;
+	const pair<const char*, ParseMode> parseModes[] = { { "parse_stream", STREAM_PARSE }, { "parse_mapped", MAPPED_PARSE },
+		{ "parse_parallel", PARALLEL_PARSE } };
+	for (const auto& [stage, parseMode] : parseModes) {
+		BenchmarkRun run = TimeBest(config.repeat, [&]() {
+			inventory.reset();
+			inventory = make_unique<Inventory>(parseMode, true, false);
+			inventory->WaitForErrorFile();
+		});
+		ReportBenchmark(stage, config.numRecords, run);
+	}
+
+	// Reloading into the same inventory reuses its columns, ID index, model arena and chunk buffers, so ingestion
+	// allocates nothing per record once the first load has sized them. The error file is left out: it formats text.
+	Inventory reloaded(PARALLEL_PARSE, false, false);
+	BenchmarkRun reload = TimeBest(config.repeat, [&]() {
+		reloaded.Clear();
+		reloaded.ParseData();
+	});
+	ReportBenchmark("reload", config.numRecords, reload);
+	{
+		Inventory snapshotWriter(PARALLEL_PARSE, false, true);
+	}
+	ReportBenchmark("parse_snapshot", config.numRecords, TimeBest(config.repeat, [&]() {
+		Inventory loaded(PARALLEL_PARSE, true, true);
+		loaded.WaitForErrorFile();
+	}));
+
+	// Validators over the generated fields, without tokenizing
+	unsigned failedRules = 0;
+	ReportBenchmark("validate_id", config.numRecords, TimeBest(config.repeat, [&]() {
+		for (string_view carID : feed.carIDs) {
+			failedRules |= inventory->ValidateCarID(carID);
+		}
+	}));
+	ReportBenchmark("validate_model", config.numRecords, TimeBest(config.repeat, [&]() {
+		for (string_view model : feed.models) {
+			failedRules |= inventory->ValidateModel(model);
+		}
+	}));
+	ReportBenchmark("validate_quantity", config.numRecords, TimeBest(config.repeat, [&]() {
+		for (int quantity : feed.quantities) {
+			failedRules |= inventory->ValidateQuantity(quantity);
+		}
+	}));
+	ReportBenchmark("validate_price", config.numRecords, TimeBest(config.repeat, [&]() {
+		for (double price : feed.prices) {
+			failedRules |= inventory->ValidatePrice(price);
+		}
+	}));
+	ReportBenchmark("validate_record", config.numRecords, TimeBest(config.repeat, [&]() {
+		for (size_t i{ 0 }; i < feed.carIDs.size(); i++) {
+			failedRules |= inventory->ValidateRecord(feed.carIDs[i], feed.models[i], feed.quantities[i], feed.prices[i]);
+		}
+	}));
+	if (failedRules == 0 && config.invalidRatio > 0 && config.numRecords > 0) {
+		cerr << "ERROR: The validators accepted every benchmark record. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
+
+	// Printing in file order, then each field sorted from scratch
+	int numCars = inventory->GetNumCars();
+	ofstream nullDevice(NULL_DEVICE);
+	ReportBenchmark("print_inventory", numCars, TimeBest(config.repeat, [&]() {
+		streambuf* console = cout.rdbuf(nullDevice.rdbuf());
+		inventory->PrintInventory();
+		cout.rdbuf(console);
+	}));
+
+	const pair<const char*, Fields> sortFields[] = { { "sort_id", ID }, { "sort_model", MODEL }, { "sort_quantity", QUANTITY },
+		{ "sort_price", PRICE } };
+	for (const auto& [stage, field] : sortFields) {
+		ReportBenchmark(stage, numCars, TimeBest(config.repeat, [&]() {
+			inventory->InvalidateOrder(field);
+			inventory->SortBy(field);
+		}));
+	}
+
+	vector<int> top;
+	ReportBenchmark("top_k_price", numCars, TimeBest(config.repeat, [&]() {
+		inventory->InvalidateOrder(PRICE);
+		inventory->TopK(PRICE, DEFAULT_TOP_K, top);
+	}));
+	ReportBenchmark("aggregate", numCars, TimeBest(config.repeat, [&]() {
+		inventory->Aggregate();
+	}));
+
+	// Stock movements through the journal: one update per record with group-committed syncs, the replay on the next
+	// load and the compaction into the base file. Both must give back the quantities the updates left, the latter
+	// even once Data.txt is newer than its snapshot and parsed again.
+	bool journalMatches = true;
+	if (numCars > 0) {
+		InventoryFiles journalFiles;
+		journalFiles.journalFileName = "Inventory.journal";
+		Inventory journaled(PARALLEL_PARSE, false, true, KEEP_FIRST, journalFiles);
+		mt19937_64 random(config.seed);
+		long long firstSyncs = journaled.GetJournalSyncs();
+
+		ReportBenchmark("journal_update", config.numRecords, TimeBest(config.repeat, [&]() {
+			for (long long u{ 0 }; u < config.numRecords; u++) {
+				journaled.AdjustQuantity((int)(random() % numCars), (random() & 1) ? 1 : -1);
+			}
+			journaled.WaitForJournal();
+		}));
+		cout << "{\"stage\":\"journal_syncs\",\"updates\":" << config.numRecords * config.repeat
+			<< ",\"syncs\":" << journaled.GetJournalSyncs() - firstSyncs << "}\n" << flush;
+
+		auto sameQuantities = [&](Inventory& other) {
+			for (int i{ 0 }; journalMatches && i < numCars; i++) {
+				journalMatches = other.GetNumCars() == numCars && other.GetCar(i).getQuantity() == journaled.GetCar(i).getQuantity();
 			}
+		};
+		ReportBenchmark("journal_replay", config.numRecords, TimeBest(config.repeat, [&]() {
+			Inventory replayed(PARALLEL_PARSE, false, true, KEEP_FIRST, journalFiles);
+			sameQuantities(replayed);
+		}));
+		ReportBenchmark("journal_compact", numCars, TimeBest(config.repeat, [&]() {
+			journaled.CompactJournal();
+			journaled.WaitForCompaction();
+		}));
+		filesystem::last_write_time("Data.txt", filesystem::file_time_type::clock::now(), error);
+		Inventory compacted(PARALLEL_PARSE, false, true, KEEP_FIRST, journalFiles);
+		sameQuantities(compacted);
+	}
+
+	inventory.reset();
+	filesystem::current_path(startDirectory);
+	filesystem::remove_all(scratchDirectory, error);
+
+	if (!journalMatches) {
+		cerr << "ERROR: The journal did not give back the updated quantities. Terminating Program\n";
+		return EXIT_FAILURE;
+	}
+	if (reload.allocations > BENCHMARK_MAX_RELOAD_ALLOCATIONS) {
+		cerr << "ERROR: A reload made " << reload.allocations << " heap allocations, more than the "
+			<< BENCHMARK_MAX_RELOAD_ALLOCATIONS << " allowed. Terminating Program\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
 
-			if (isMinVal) {
-				minIndex = j;
+// Reads the benchmark options; an unknown option or a missing or out-of-range value ends the program with EXIT_USAGE
+void ParseBenchmarkArgs(int argc, char* argv[], BenchmarkConfig& config) {
+	for (int i{ 0 }; i < argc; i++) {
+		string option = argv[i];
+		if (i + 1 == argc) {
+			cerr << "ERROR: Missing value for benchmark option '" << option << "'\n";
+			exit(EXIT_USAGE);
+		}
+
+		string value = argv[++i];
+		bool valid = true;
+		try {
+			if (option == "--records") {
+				config.numRecords = stoll(value);
+				valid = config.numRecords >= 1 && config.numRecords <= numeric_limits<int>::max();
+			}
+			else if (option == "--invalid-ratio") {
+				config.invalidRatio = stod(value);
+				valid = config.invalidRatio >= 0 && config.invalidRatio <= 1;
+			}
+			else if (option == "--duplicate-ratio") {
+				config.duplicateRatio = stod(value);
+				valid = config.duplicateRatio >= 0 && config.duplicateRatio <= 1;
+			}
+			else if (option == "--ids") {
+				config.sequentialIds = (value == "sequential");
+				valid = config.sequentialIds || value == "random";
+			}
+			else if (option == "--models") {
+				config.numModels = stoi(value);
+				valid = config.numModels >= 1;
+			}
+			else if (option == "--model-skew") {
+				config.modelSkew = stod(value);
+				valid = config.modelSkew >= 0;
+			}
+			else if (option == "--seed") {
+				config.seed = stoull(value);
 			}
+			else if (option == "--repeat") {
+				config.repeat = stoi(value);
+				valid = config.repeat >= 1;
+			}
+			else {
+				cerr << "ERROR: Unknown benchmark option '" << option << "'\n";
+				exit(EXIT_USAGE);
+			}
+		}
+		catch (const exception&) {
+			valid = false;
+		}
+
+		if (!valid) {
+			cerr << "ERROR: Invalid value '" << value << "' for benchmark option '" << option << "'\n";
+			exit(EXIT_USAGE);
 		}
-		temp = carPtrs[minIndex];
-		carPtrs[minIndex] = carPtrs[i];
-		carPtrs[i] = temp;
 	}
 }
 
-// Takes in a string and converts all alphabetical characters to uppercase
-void Inventory::MakeStringUppercase(string& str) {
-	for (int i{ 0 }; i < str.length(); i++) {
-		str[i] = toupper(str[i]);
+// Writes config.numRecords lines to Data.txt and keeps their fields in feed. Car IDs are drawn per position from the
+// character class the active rule set requires there (or count up through the ID space), models follow a Zipf
+// distribution over config.numModels names, and an invalid line breaks exactly one rule of one field.
+void GenerateBenchmarkFeed(const BenchmarkConfig& config, BenchmarkFeed& feed) {
+	const char* modelStems[] = { "Camry", "Civic", "Fusion", "Mustang", "Corolla", "Sonata", "Prius", "Accord", "Wrangler", "Corvette" };
+	mt19937_64 random(config.seed);
+	uniform_real_distribution<double> unit(0, 1);
+	vector<string> idChars(REQ_ID_LEN);
+	vector<string> modelNames(config.numModels);
+	vector<double> modelCdf(config.numModels);
+	vector<size_t> idOffsets, modelOffsets;
+	char line[64];
+
+	for (const IdSegment& segment : ActiveRules::ID_SEGMENTS) {
+		for (int c{ 0 }; c < 256; c++) {
+			if (CHAR_CLASSES.classes[c] & segment.charClass) {
+				for (int position{ segment.begin }; position < segment.end; position++) {
+					idChars[position] += (char)c;
+				}
+			}
+		}
 	}
-}
 
-void Inventory::PrintInventory() {
-	stringstream ssHeader;
+	double weightSum = 0;
+	for (int m{ 0 }; m < config.numModels; m++) {
+		modelNames[m] = string(modelStems[m % 10]) + to_string(m / 10);
+		weightSum += 1 / pow(m + 1.0, config.modelSkew);
+		modelCdf[m] = weightSum;
+	}
 
-	ssHeader << fixed << showpoint << setprecision(2) << left
-		<< setw(TEXT_WIDTH) << "Vehicle ID"
-		<< setw(TEXT_WIDTH) << "Model"
-		<< setw(NUM_WIDTH) << right << "Quantity"
-		<< setw(NUM_WIDTH) << "Price" << left << "\n\n";
+	ofstream dataFile("Data.txt", ios::binary);
+	if (!dataFile) {
+		cerr << "ERROR: Unable to create the benchmark 'Data.txt'. Terminating Program\n";
+		exit(EXIT_FAILURE);
+	}
 
-	cout << "VALID ITEMS IN THE INVENTORY\n"
-		<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n" //use setfill print -
-		<< setfill(' ') // Reset setfill to default space character
-		<< ssHeader.str();
+	feed = BenchmarkFeed();
+	feed.text.reserve((size_t)config.numRecords * EST_RECORD_BYTES);
+	for (long long r{ 0 }; r < config.numRecords; r++) {
+		string carID(REQ_ID_LEN, ' ');
+		if (r > 0 && unit(random) < config.duplicateRatio) {
+			size_t earlier = idOffsets[random() % idOffsets.size()];
+			carID.assign(feed.text, earlier, feed.text.find(' ', earlier) - earlier);
+		}
+		else {
+			unsigned long long sequence = (unsigned long long)r;
+			for (int position{ REQ_ID_LEN - 1 }; position >= 0; position--) {
+				const string& chars = idChars[position];
+				if (config.sequentialIds) {
+					carID[position] = chars[sequence % chars.size()];
+					sequence /= chars.size();
+				}
+				else {
+					carID[position] = chars[random() % chars.size()];
+				}
+			}
+		}
+
+		string model = modelNames[lower_bound(modelCdf.begin(), modelCdf.end(), unit(random) * weightSum) - modelCdf.begin()];
+		int quantity = (int)(random() % 51);
+		double price = (MIN_PRICE + 1 + (int)(random() % 115000)) + (int)(random() % 100) / 100.0;
+
+		if (unit(random) < config.invalidRatio) {
+			switch (random() % 4) {
+			case 0:
+				carID.pop_back();
+				break;
+			case 1:
+				model[0] = (char)tolower(model[0]);
+				break;
+			case 2:
+				quantity = MIN_QUANTITY - 1 - quantity;
+				break;
+			default:
+				price = (double)(random() % (MIN_PRICE + 1));
+				break;
+			}
+		}
+
+		int length = snprintf(line, sizeof(line), " %d %.2f\n", quantity, price);
+		idOffsets.push_back(feed.text.size());
+		feed.text += carID;
+		feed.text += ' ';
+		modelOffsets.push_back(feed.text.size());
+		feed.text += model;
+		feed.text.append(line, length);
+		feed.quantities.push_back(quantity);
+		feed.prices.push_back(price);
+	}
 
-	string recordString{ "" };
+	// The text no longer moves, so the ID and model views can point into it
+	for (size_t r{ 0 }; r < idOffsets.size(); r++) {
+		feed.carIDs.emplace_back(feed.text.data() + idOffsets[r], feed.text.find(' ', idOffsets[r]) - idOffsets[r]);
+		feed.models.emplace_back(feed.text.data() + modelOffsets[r], feed.text.find(' ', modelOffsets[r]) - modelOffsets[r]);
+	}
 
-	if (carPtrs == nullptr) {
-		cout << "Error: Inventory not initialized properly. Terminating Program\n\n";
+	dataFile.write(feed.text.data(), feed.text.size());
+	if (!dataFile.flush()) {
+		cerr << "ERROR: Unable to write the benchmark 'Data.txt'. Terminating Program\n";
 		exit(EXIT_FAILURE);
 	}
+}
 
+// Stress mode: loads a generated inventory, then runs rounds in which this thread, as the writer, moves stock between
+// random pairs of records and publishes a version after every STRESS_TRANSFERS_PER_VERSION transfers, while 1, 2, 4,
+// ... config.maxReaders reader threads refresh to the latest version and check it over and over. Every version must
+// hold all records with the total quantity of the first one, every price must still match its record's quantity
+// (the writer changes both together), a quantity sort must come out in order and versions must never go backwards.
+// Each round is reported as one JSON object per line; any inconsistency ends the run with EXIT_FAILURE.
+// Usage: --stress [--records N] [--readers N] [--seconds S] [--seed N]
+int RunStress(int argc, char* argv[]) {
+	StressConfig config;
+	BenchmarkConfig feedConfig;
+	BenchmarkFeed feed;
+	error_code error;
+
+	ParseStressArgs(argc, argv, config);
+
+	filesystem::path startDirectory = filesystem::current_path();
+	filesystem::path scratchDirectory = EnterScratchDirectory("inventory-stress-");
+
+	feedConfig.numRecords = config.numRecords;
+	feedConfig.invalidRatio = 0;
+	feedConfig.seed = config.seed;
+	GenerateBenchmarkFeed(feedConfig, feed);
+
+	Inventory inventory(PARALLEL_PARSE, false, false);
+	int numCars = inventory.GetNumCars();
 	for (int i{ 0 }; i < numCars; i++) {
-		recordString = carPtrs[i]->toString();
-		cout << recordString;
+		inventory.SetPrice(i, STRESS_BASE_PRICE + inventory.GetCar(i).getQuantity());
 	}
-	cout << "\nTotal Records: " << numCars << "\n"
-		<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
-		<< setfill(' ') << "\n\n";
-}
+	inventory.Publish();
+	long long totalQuantity = inventory.Aggregate().totalQuantity;
 
-int GetMenuSelection() {
-	int selection;
+	filesystem::current_path(startDirectory);
+	filesystem::remove_all(scratchDirectory, error);
 
-	cout << "Main Menu:\n"
-		"Please select one of the following options:\n"
-		"1. Valid Records\n"
-		"2. Invalid Records\n"
-		"3. Sort Inventory\n"
-		"4. Quit program\n"
-		"Selection: ";
-	cin >> selection;
-	cout << endl;
+	// One consistency check of a reader's version; returns the number of violations found
+	auto checkVersion = [&](const InventoryReader& reader, vector<int>& order) {
+		long long violations = 0;
+		InventoryAggregate aggregate = reader.Aggregate();
 
-	return selection;
-}
+		violations += (reader.GetNumCars() != numCars) + (aggregate.totalQuantity != totalQuantity);
+		for (int i{ 0 }; i < reader.GetNumCars(); i++) {
+			Car car = reader.GetCar(i);
+			violations += (car.getPrice() != STRESS_BASE_PRICE + car.getQuantity());
+		}
+		reader.SortBy(QUANTITY, order);
+		for (size_t i{ 1 }; i < order.size(); i++) {
+			violations += (reader.GetCar(order[i - 1]).getQuantity() < reader.GetCar(order[i]).getQuantity());
+		}
+		return violations;
+	};
+
+	mt19937_64 random(config.seed);
+	uniform_int_distribution<int> pickRecord(0, numCars - 1);
+	long long totalViolations = 0;
+
+	for (int numReaders{ 1 }; ; numReaders = min(numReaders * 2, config.maxReaders)) {
+		atomic<bool> stopReading{ false };
+		atomic<long long> violations{ 0 };
+		vector<long long> numChecks(numReaders, 0);
+		vector<thread> readers;
+
+		for (int r{ 0 }; r < numReaders; r++) {
+			readers.emplace_back([&, r]() {
+				InventoryReader reader(inventory);
+				vector<int> order;
+				uint64_t lastVersion = 0;
+				long long checks = 0;
+
+				while (!stopReading) {
+					reader.Refresh();
+					violations += checkVersion(reader, order) + (reader.GetVersion() < lastVersion);
+					lastVersion = reader.GetVersion();
+					checks++;
+				}
+				numChecks[r] = checks;
+			});
+		}
 
-void SortMenu(Inventory& inventory) {
-	int field = GetSortKey();
+		long long numTransfers = 0;
+		long long numVersions = 0;
+		auto start = chrono::steady_clock::now();
+		auto deadline = start + chrono::duration<double>(config.seconds);
+
+		while (chrono::steady_clock::now() < deadline) {
+			for (int t{ 0 }; t < STRESS_TRANSFERS_PER_VERSION && numCars > 1; t++) {
+				int from = pickRecord(random);
+				int to = pickRecord(random);
+				int fromQuantity = inventory.GetCar(from).getQuantity();
+				int moved = (from == to || fromQuantity == 0) ? 0 : (int)(random() % fromQuantity) + 1;
+				int toQuantity = inventory.GetCar(to).getQuantity() + moved;
+
+				inventory.SetQuantity(from, fromQuantity - moved);
+				inventory.SetPrice(from, STRESS_BASE_PRICE + fromQuantity - moved);
+				inventory.SetQuantity(to, toQuantity);
+				inventory.SetPrice(to, STRESS_BASE_PRICE + toQuantity);
+				numTransfers++;
+			}
+			inventory.Publish();
+			numVersions++;
+		}
+		stopReading = true;
+		for (thread& reader : readers) {
+			reader.join();
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-	if (field != RETURN_TO_MAIN) {
-		switch (field) {
-		case ID:
-			cout << "Sorting by ID\n\n";
-			break;
-		case MODEL:
-			cout << "Sorting by Model\n\n";
-			break;
-		case QUANTITY:
-			cout << "Sorting by Quantity\n\n";
-			break;
-		case PRICE:
-			cout << "Sorting by Price\n\n";
+		long long totalChecks = 0;
+		for (long long checks : numChecks) {
+			totalChecks += checks;
+		}
+		totalViolations += violations;
+
+		ostringstream result;
+		result << fixed << setprecision(6) << "{\"stage\":\"stress\",\"records\":" << numCars << ",\"readers\":" << numReaders
+			<< ",\"seconds\":" << seconds << setprecision(0) << ",\"checks_per_sec\":" << totalChecks / seconds
+			<< ",\"records_read_per_sec\":" << totalChecks * (double)numCars / seconds
+			<< ",\"versions_per_sec\":" << numVersions / seconds << ",\"transfers_per_sec\":" << numTransfers / seconds
+			<< ",\"violations\":" << violations << ",\"peak_rss_kb\":" << PeakRssKB() << "}\n";
+		cout << result.str() << flush;
+
+		if (numReaders == config.maxReaders) {
 			break;
-		default:
-			PurgeInputErrors("ERROR: Invalid case in SortMenu. Terminating Program.\n");
-			exit(EXIT_FAILURE);
 		}
-		inventory.SortBy(field);
-		inventory.PrintInventory();
 	}
-	else {
-		cout << "Returning to Main Menu\n\n";
+
+	if (totalViolations > 0) {
+		cerr << "ERROR: Readers saw " << totalViolations << " inconsistent version(s). Terminating Program\n";
+		return EXIT_FAILURE;
 	}
+	return EXIT_SUCCESS;
 }
 
-int GetSortKey() {
-	int key;
-
-	do {
-		cout << "Sort Menu:\n"
-			"Please select one of the following sorting options:\n"
-			"1. ID\n"
-			"2. Model\n"
-			"3. Quantity\n"
-			"4. Price\n"
-			"5. Return to Main Menu\n"
-			"Selection: ";
-
-		cin >> key;
-		cout << "\n";
+// Reads the stress options; an unknown option or a missing or out-of-range value ends the program with EXIT_USAGE
+void ParseStressArgs(int argc, char* argv[], StressConfig& config) {
+	for (int i{ 0 }; i < argc; i++) {
+		string option = argv[i];
+		if (i + 1 == argc) {
+			cerr << "ERROR: Missing value for stress option '" << option << "'\n";
+			exit(EXIT_USAGE);
+		}
 
-		if (key < ID || key > RETURN_TO_MAIN) {
-			PurgeInputErrors("Error: Invalid menu selection\n\n");
+		string value = argv[++i];
+		bool valid = true;
+		try {
+			if (option == "--records") {
+				config.numRecords = stoll(value);
+				valid = config.numRecords >= 2 && config.numRecords <= numeric_limits<int>::max();
+			}
+			else if (option == "--readers") {
+				config.maxReaders = stoi(value);
+				valid = config.maxReaders >= 1 && config.maxReaders <= MAX_INVENTORY_READERS;
+			}
+			else if (option == "--seconds") {
+				config.seconds = stod(value);
+				valid = config.seconds > 0;
+			}
+			else if (option == "--seed") {
+				config.seed = stoull(value);
+			}
+			else {
+				cerr << "ERROR: Unknown stress option '" << option << "'\n";
+				exit(EXIT_USAGE);
+			}
+		}
+		catch (const exception&) {
+			valid = false;
 		}
-	} while (key < ID || key > RETURN_TO_MAIN);
 
-	return key;
+		if (!valid) {
+			cerr << "ERROR: Invalid value '" << value << "' for stress option '" << option << "'\n";
+			exit(EXIT_USAGE);
+		}
+	}
 }
 
-void PrintInvalidRecords() {
-	string errorFileName{ "ErrorFile.txt" };
-	ifstream Errfile(errorFileName);
-	stringstream ssHeader;
-	int invalidRecordCount{ 0 };
-
-	cout << fixed << showpoint << setprecision(2);
-	ssHeader << fixed << showpoint << setprecision(2) << left
-		<< setw(TEXT_WIDTH) << "Vehicle ID"
-		<< setw(TEXT_WIDTH) << "Model"
-		<< setw(NUM_WIDTH) << right << "Quantity"
-		<< setw(NUM_WIDTH) << "Price" << left << "\n\n";
+// Creates an empty directory named prefix plus a timestamp under the system temp directory and makes it the
+// working directory, so generated feeds and output files never touch the user's Data.txt
+filesystem::path EnterScratchDirectory(const string& prefix) {
+	error_code error;
+	filesystem::path scratchDirectory = filesystem::temp_directory_path(error)
+		/ (prefix + to_string(chrono::steady_clock::now().time_since_epoch().count()));
 
-	if (!Errfile.is_open()) {
-		cout << "ERROR: Unable to open file.\n\n";
+	if (error || !filesystem::create_directories(scratchDirectory, error)) {
+		cerr << "ERROR: Unable to create a scratch directory. Terminating Program\n";
 		exit(EXIT_FAILURE);
 	}
-	else if (Errfile.peek() == EOF) {
-		cout << "No Invalid Records Found.\n\n";
+	filesystem::current_path(scratchDirectory);
+	return scratchDirectory;
+}
+
+// Runs work repeat times and returns the fastest time in seconds and the fewest heap allocations of any run
+template <typename Work>
+BenchmarkRun TimeBest(int repeat, Work work) {
+	BenchmarkRun best{ numeric_limits<double>::infinity(), numeric_limits<long long>::max() };
+
+	for (int run{ 0 }; run < repeat; run++) {
+		long long allocations = GetNumAllocations();
+		auto start = chrono::steady_clock::now();
+		work();
+		best.seconds = min(best.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+		best.allocations = (allocations < 0) ? -1 : min(best.allocations, GetNumAllocations() - allocations);
+	}
+	return best;
+}
+
+// Prints one benchmark result as a JSON object on its own line
+void ReportBenchmark(const string& stage, long long records, const BenchmarkRun& run) {
+	ostringstream result;
+	double seconds = run.seconds;
+
+	result << fixed << setprecision(6) << "{\"stage\":\"" << stage << "\",\"records\":" << records << ",\"seconds\":" << seconds
+		<< setprecision(0) << ",\"records_per_sec\":" << ((seconds > 0) ? records / seconds : 0.0)
+		<< setprecision(2) << ",\"ns_per_record\":" << ((records > 0) ? seconds * 1e9 / records : 0.0)
+		<< ",\"peak_rss_kb\":" << PeakRssKB();
+	if (run.allocations < 0) {
+		result << ",\"allocations\":null,\"allocations_per_record\":null";
 	}
 	else {
-		cout << "INVALID RECORDS\n"
-			<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
-			<< setfill(' ') << ssHeader.str();
+		result << ",\"allocations\":" << run.allocations << setprecision(4)
+			<< ",\"allocations_per_record\":" << ((records > 0) ? (double)run.allocations / records : 0.0);
+	}
+	result << "}\n";
+	cout << result.str() << flush;
+}
 
-		string line;
-		while (getline(Errfile, line)) {
-			cout << line << endl;
-		}
-		cout << "\nTotal Records: " << invalidRecordCount << "\n"
-			<< setfill('-') << setw(HEADER_WIDTH) << "-" << "\n"
-			<< setfill(' ') << "\n\n";
+// Largest resident set size of this process so far, in kilobytes
+long long PeakRssKB() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? (long long)(counters.PeakWorkingSetSize / 1024) : 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
 
-		Errfile.close();
+// Build with -DINVENTORY_COUNT_ALLOCATIONS to count every heap allocation of the process, so the benchmark can report
+// allocations per stage. The replacement operators only add a relaxed counter increment to malloc and free.
+#ifdef INVENTORY_COUNT_ALLOCATIONS
+atomic<long long> numAllocations{ 0 };
+
+// GCC flags the free() these operators end in once they are inlined into a delete[] of a new[] block
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+	numAllocations.fetch_add(1, memory_order_relaxed);
+	void* block = malloc((size > 0) ? size : 1);
+	if (block == nullptr) {
+		throw bad_alloc();
 	}
+	return block;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* block) noexcept { free(block); }
+void operator delete[](void* block) noexcept { operator delete(block); }
+void operator delete(void* block, size_t) noexcept { operator delete(block); }
+void operator delete[](void* block, size_t) noexcept { operator delete(block); }
+#endif
+
+// Heap allocations made by the process so far, or -1 when the build does not count them
+long long GetNumAllocations() {
+#ifdef INVENTORY_COUNT_ALLOCATIONS
+	return numAllocations.load();
+#else
+	return -1;
+#endif
 }
 
 // Clears the error state of cin and ignores any remaining invalid input in the buffer
@@ -500,6 +4997,211 @@ void PurgeInputErrors(string errMess) {
 	}
 }
 
+// Describes the requirement of one Car ID segment for error messages, e.g. "First 2 characters of Car ID must be ..."
+string DescribeIdSegment(const IdSegment& segment) {
+	string description;
+
+	if (segment.begin == 0) {
+		description = "First " + to_string(segment.end) + " characters of Car ID must be ";
+	}
+	else if (segment.end - segment.begin == 1) {
+		description = "Character " + to_string(segment.end) + " of Car ID must be ";
+	}
+	else {
+		description = "Characters " + to_string(segment.begin + 1) + "-" + to_string(segment.end) + " of Car ID must be ";
+	}
+
+	switch (segment.charClass) {
+	case CLASS_ID_LETTER:
+		description += "letters alpha only (A-Z, letter O is not allowed) ";
+		break;
+	case CLASS_ID_ALNUM:
+		description += "alphanumeric (A-Z, 0-9, letter O is not allowed) ";
+		break;
+	case CLASS_DIGIT:
+		description += "numeric ";
+		break;
+	default:
+		description += "valid ";
+	}
+	return description;
+}
+
+// Returns the message DescribeFailedRules builds for failedRules, building it only the first time
+const string& RuleMessageCache::Get(unsigned failedRules) {
+	auto it = lower_bound(messages.begin(), messages.end(), failedRules,
+		[](const pair<unsigned, string>& entry, unsigned rules) { return entry.first < rules; });
+	if (it == messages.end() || it->first != failedRules) {
+		it = messages.insert(it, { failedRules, DescribeFailedRules(failedRules) });
+	}
+	return it->second;
+}
+
+// Builds the error report text for a set of failed RULE_* bits. Sections always appear in the same order
+// (ID, Model, Quant, Price), so a record's message depends only on which rules it failed.
+string DescribeFailedRules(unsigned failedRules) {
+	string message;
+
+	if (failedRules & INVALID_ID) {
+		message += "Invalid ID:    [ ";
+		if (failedRules & RULE_ID_LENGTH) {
+			message += "Car ID must be " + to_string(REQ_ID_LEN) + " characters long ";
+		}
+		for (int s{ 0 }; s < ActiveValidator::NUM_SEGMENTS; s++) {
+			if (failedRules & (1u << (RULE_ID_SEGMENT_SHIFT + s))) {
+				message += DescribeIdSegment(ActiveRules::ID_SEGMENTS[s]);
+			}
+		}
+		message += "]";
+	}
+	if (failedRules & INVALID_MODEL) {
+		message += "Invalid Model: [ ";
+		if (failedRules & RULE_MODEL_LENGTH) {
+			message += "Model must be at least " + to_string(MIN_MODEL_LEN) + " characters long";
+		}
+		if (failedRules & RULE_MODEL_FIRST) {
+			message += "Model must start with a capital letter (A-Z, letter O is not allowed) ";
+		}
+		if (failedRules & RULE_MODEL_ALNUM) {
+			message += "Model must must be alphanumeric (A-Z, 0-9, letter 0 is not allowed) ";
+		}
+		message += "] ";
+	}
+	if (failedRules & RULE_QUANTITY) {
+		message += "Invalid Quant: [ Quantity must be greater than or equal to " + to_string(MIN_QUANTITY) + " ] ";
+	}
+	if (failedRules & RULE_PRICE) {
+		message += "Invalid Price: [ Price must be greater than $" + to_string(MIN_PRICE) + " ]";
+	}
+	return message;
+}
+
+// Hashes size bytes a word at a time (any tail byte by byte), continuing from hash so a buffer can be hashed in pieces
+uint64_t Checksum64(const char* data, size_t size, uint64_t hash) {
+	const uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+	size_t i = 0;
+
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ (unsigned char)data[i]) * MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+// Runs task(0) .. task(numTasks - 1) on their own threads, with the last task on the calling thread, and waits for all of them
+void RunParallel(int numTasks, const function<void(int)>& task) {
+	vector<thread> workers;
+
+	for (int t{ 0 }; t < numTasks - 1; t++) {
+		workers.emplace_back(task, t);
+	}
+	if (numTasks > 0) {
+		task(numTasks - 1);
+	}
+	for (thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// Runs produce(0) .. produce(numTasks - 1) on up to numThreads workers, which claim tasks in order, while the calling
+// thread runs consume(i) for each task in the same order as soon as produce(i) has finished. A worker only starts a
+// task once it is within PIPELINE_TASKS_AHEAD tasks per worker of the consumer, so finished, unconsumed tasks (and
+// the memory they hold) stay bounded however far the consumer falls behind.
+void RunPipelined(int numTasks, int numThreads, const function<void(int)>& produce, const function<void(int)>& consume) {
+	numThreads = min(numThreads, numTasks);
+
+	if (numThreads <= 1) {
+		for (int i{ 0 }; i < numTasks; i++) {
+			produce(i);
+			consume(i);
+		}
+		return;
+	}
+
+	atomic<int> nextTask{ 0 };
+	vector<char> taskDone(numTasks, false);
+	int numConsumed = 0;
+	int window = numThreads * PIPELINE_TASKS_AHEAD;
+	mutex doneMutex;
+	condition_variable doneSignal;
+	vector<thread> workers;
+
+	for (int t{ 0 }; t < numThreads; t++) {
+		workers.emplace_back([&]() {
+			int i;
+			while ((i = nextTask++) < numTasks) {
+				{
+					unique_lock<mutex> lock(doneMutex);
+					doneSignal.wait(lock, [&]() { return i < numConsumed + window; });
+				}
+				produce(i);
+
+				lock_guard<mutex> lock(doneMutex);
+				taskDone[i] = true;
+				doneSignal.notify_all();
+			}
+		});
+	}
+
+	for (int i{ 0 }; i < numTasks; i++) {
+		{
+			unique_lock<mutex> lock(doneMutex);
+			doneSignal.wait(lock, [&]() { return taskDone[i] != 0; });
+		}
+		consume(i);
+
+		lock_guard<mutex> lock(doneMutex);
+		numConsumed = i + 1;
+		doneSignal.notify_all();
+	}
+
+	for (thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// Stable LSD radix sort on RADIX_BITS-wide digits, ascending by key. All digit histograms are built in one pass,
+// and digit positions that hold the same value in every key are skipped.
+template <typename Key>
+void RadixSort(vector<KeyedIndex<Key>>& items) {
+	const int NUM_DIGITS = (sizeof(Key) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+	const int NUM_BUCKETS = 1 << RADIX_BITS;
+	const Key DIGIT_MASK = NUM_BUCKETS - 1;
+	size_t numItems = items.size();
+	vector<size_t> counts(NUM_DIGITS * NUM_BUCKETS, 0);
+
+	for (const KeyedIndex<Key>& item : items) {
+		for (int d{ 0 }; d < NUM_DIGITS; d++) {
+			counts[d * NUM_BUCKETS + ((item.key >> (RADIX_BITS * d)) & DIGIT_MASK)]++;
+		}
+	}
+
+	vector<KeyedIndex<Key>> buffer(numItems);
+	for (int d{ 0 }; d < NUM_DIGITS; d++) {
+		size_t* digitCounts = &counts[d * NUM_BUCKETS];
+		if (numItems == 0 || digitCounts[(items[0].key >> (RADIX_BITS * d)) & DIGIT_MASK] == numItems) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int v{ 0 }; v < NUM_BUCKETS; v++) {
+			size_t count = digitCounts[v];
+			digitCounts[v] = offset;
+			offset += count;
+		}
+		for (const KeyedIndex<Key>& item : items) {
+			buffer[digitCounts[(item.key >> (RADIX_BITS * d)) & DIGIT_MASK]++] = item;
+		}
+		items.swap(buffer);
+	}
+}
+
 /*
 TEST DATA
 
@@ -801,4 +5503,4 @@ Selection:
 
 
 
-*/
\ No newline at end of file
+*/